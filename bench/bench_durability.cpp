@@ -0,0 +1,70 @@
+// Durability benchmark: time a commit-shaped transaction (one new object plus the
+// index, commit set and branch ref) under each GITLITE_FSYNC mode.
+// Each mode runs in its own child process because the mode is read once per process.
+// Usage: bench_durability [operations] [directory]
+// The directory should be on the file system being measured; tmpfs makes every sync free.
+#include "Durable.h"
+#include "Serialization.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+double run(const fs::path& root, size_t ops) {
+    fs::create_directories(root / "objects");
+    fs::create_directories(root / "refs" / "heads");
+    std::set<std::string> commits;
+    std::string blob(4096, 'x');
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        auto id = std::format("{:040x}", i + 1);
+        blob.replace(0, id.size(), id);
+        commits.insert(id);
+        durable::Transaction tx;
+        auto object = root / "objects" / id.substr(0, 2) / id.substr(2);
+        fs::create_directories(object.parent_path());
+        durable::write_file(object, blob);
+        ser::serialize_to_safe_file(std::map<std::string, std::string>{{"file.txt", id}}, root / "INDEX1");
+        ser::serialize_to_safe_file(std::set<std::string>{}, root / "INDEX2");
+        ser::serialize_to_safe_file(commits, root / "COMMITS");
+        ser::serialize_to_safe_file(std::string_view(id), root / "refs" / "heads" / "master");
+        tx.commit();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t ops = argc > 1 ? std::stoul(argv[1]) : 200;
+    fs::path base = argc > 2 ? fs::path(argv[2]) : fs::temp_directory_path();
+    base /= std::format("gitlite_bench_durability_{}", ::getpid());
+
+    std::cout << std::format("{} transactions, 5 files each, in {}\n", ops, base.parent_path().string());
+    std::cout << std::format("{:>6} {:>10} {:>10}\n", "mode", "ms", "ms/op");
+    for (const char* mode : {"none", "batch", "full"}) {
+        std::cout.flush();
+        pid_t pid = ::fork();
+        if (pid == 0) {
+            ::setenv("GITLITE_FSYNC", mode, 1);
+            double ms = run(base / mode, ops);
+            std::cout << std::format("{:>6} {:>10.1f} {:>10.3f}\n", mode, ms, ms / static_cast<double>(ops));
+            std::cout.flush();
+            std::_Exit(0);
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+    }
+    fs::remove_all(base);
+    return 0;
+}
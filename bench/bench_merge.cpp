@@ -0,0 +1,64 @@
+// Three-way merge benchmark: large files with scattered, non-overlapping edits on both sides.
+#include "Diff.h"
+#include "Utils.h"
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <string>
+
+namespace {
+
+std::string make_file(size_t lines, size_t every, size_t offset, std::string_view tag) {
+    std::string out;
+    out.reserve(lines * 24);
+    for (size_t i = 0; i < lines; ++i) {
+        if (every != 0 && i % every == offset) {
+            out.append(std::format("{} edit {}\n", tag, i));
+        } else {
+            out.append(std::format("line {} of the file\n", i));
+        }
+    }
+    return out;
+}
+
+template <typename F>
+double time_ms(F&& f, int reps) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; ++i) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / reps;
+}
+
+} // namespace
+
+int main() {
+    std::cout << std::format("{:>8} {:>6} {:>12} {:>12} {:>10}\n", "lines", "edits", "merge3 ms", "sha1 ms", "conflicts");
+    for (size_t lines : {1000UL, 10000UL, 100000UL}) {
+        const size_t every = 500;
+        auto base = make_file(lines, 0, 0, "");
+        auto a = make_file(lines, every, 10, "ours");
+        auto b = make_file(lines, every, 250, "theirs");
+
+        std::string merged;
+        std::string id;
+        bool clean = true;
+        double mergeMs = time_ms(
+            [&] {
+                merged.clear();
+                clean = diff::merge3(base, a, b, merged);
+            },
+            5);
+        double hashMs = time_ms(
+            [&] {
+                SHA1::Context ctx;
+                ctx.update(merged);
+                id = ctx.digest();
+            },
+            5);
+        std::cout << std::format(
+            "{:>8} {:>6} {:>12.3f} {:>12.3f} {:>10}\n", lines, 2 * (lines / every), mergeMs, hashMs, clean ? 0 : 1);
+    }
+    return 0;
+}
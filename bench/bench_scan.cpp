@@ -0,0 +1,94 @@
+// Commit scan benchmark: decode a synthetic commit set with 1..N worker threads,
+// then compare header-only and full decoding as the tree grows.
+// Usage: bench_scan [commits] [max jobs]
+#include "CommitScanner.h"
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<fs::path> make_commits(const fs::path& dir, size_t count, size_t files) {
+    std::vector<fs::path> paths;
+    paths.reserve(count);
+    std::string parent(40, '0');
+    for (size_t i = 0; i < count; ++i) {
+        Commit comm(std::format("Commit number {}", i), std::chrono::system_clock::now());
+        comm.id = std::format("{:040x}", i + 1);
+        comm.parents.push_back(parent);
+        for (size_t f = 0; f < files; ++f) {
+            comm.mapping.emplace(std::format("dir/file{}.txt", f), std::format("{:040x}", i * files + f));
+        }
+        auto path = dir / comm.id.substr(0, 2) / comm.id.substr(2);
+        fs::create_directories(path.parent_path());
+        ser::serialize_to_file(comm, path);
+        paths.push_back(std::move(path));
+        parent = comm.id;
+    }
+    return paths;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 20000;
+    const size_t files = 64;
+    auto dir = fs::temp_directory_path() / std::format("gitlite_bench_scan_{}", ::getpid());
+    auto paths = make_commits(dir, count, files);
+
+    const unsigned maxJobs =
+        argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : std::max(1U, std::thread::hardware_concurrency());
+    double serialMs = 0;
+    std::cout << std::format("{} commits, {} files each\n", count, files);
+    std::cout << std::format("{:>6} {:>10} {:>9}\n", "jobs", "ms", "speedup");
+    std::vector<unsigned> jobCounts;
+    for (unsigned jobs = 1; jobs < maxJobs; jobs *= 2) {
+        jobCounts.push_back(jobs);
+    }
+    jobCounts.push_back(maxJobs);
+    for (unsigned jobs : jobCounts) {
+        size_t bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+        scan::for_each_commit(
+            paths,
+            jobs,
+            [](Commit& comm) { return comm.message; },
+            [&](size_t, std::string& text) {
+                bytes += text.size();
+                return true;
+            },
+            scan::Decode::Full);
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (jobs == 1) {
+            serialMs = ms;
+        }
+        std::cout << std::format("{:>6} {:>10.1f} {:>8.2f}x\n", jobs, ms, serialMs / ms);
+    }
+    fs::remove_all(dir);
+
+    // log 只需要提交头：耗时应与每个提交的文件数无关
+    const size_t logCommits = 200;
+    std::cout << std::format("\n{} commits, single thread\n", logCommits);
+    std::cout << std::format("{:>8} {:>12} {:>12}\n", "files", "full ms", "header ms");
+    for (size_t treeSize : {16UL, 256UL, 4096UL}) {
+        auto treeDir = dir.string() + std::format("_{}", treeSize);
+        auto treePaths = make_commits(treeDir, logCommits, treeSize);
+        double ms[2];
+        for (auto decode : {scan::Decode::Full, scan::Decode::Header}) {
+            auto start = std::chrono::steady_clock::now();
+            scan::for_each_commit(
+                treePaths, 1, [](Commit& comm) { return comm.message; }, [](size_t, std::string&) { return true; }, decode);
+            auto end = std::chrono::steady_clock::now();
+            ms[decode == scan::Decode::Header] = std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        std::cout << std::format("{:>8} {:>12.1f} {:>12.1f}\n", treeSize, ms[0], ms[1]);
+        fs::remove_all(treeDir);
+    }
+}
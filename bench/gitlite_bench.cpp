@@ -0,0 +1,347 @@
+// End-to-end benchmark: generate a repository of a given shape with the gitlite executable, then
+// time add, commit, log, global-log, find, checkout, reset, merge and status against it.
+// Every command runs as its own process, as in real use, so latency includes start-up and the
+// peak RSS is the child's maximum resident set. Results go to stdout as one JSON object.
+// Usage: gitlite_bench [--files=N] [--size=BYTES] [--commits=N] [--branches=N] [--merge-every=N]
+//                      [--changes=N] [--runs=N] [--seed=N] [--dir=PATH] [--keep] [--gitlite=PATH]
+// The same options and seed always generate the same repository. Large shapes take a while to
+// generate (one process per added file), so keep one with --dir=PATH --keep: a later run with the
+// same --dir skips generation. The timed runs add commits and branches to the repository they use.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Options {
+    size_t files = 1000;
+    size_t size = 1024;     // 文件的平均字节数，实际在 [size/2, size*3/2] 之间
+    size_t commits = 100;
+    size_t branches = 4;    // 含 master，至少为 2
+    size_t mergeEvery = 5;  // 侧分支每提交这么多次并回 master 一次，0 表示不合并
+    size_t changes = 10;    // 每次提交修改的文件数
+    size_t runs = 20;       // 每个命令计时的次数
+    uint64_t seed = 1;
+    fs::path dir;
+    bool keep = false;
+    fs::path gitlite = GITLITE_BINARY;
+};
+
+struct Sample {
+    double ms = 0;
+    long maxRssKb = 0;
+};
+
+// 运行 gitlite 的一个命令；output 非空时收集其标准输出，否则丢弃
+Sample run(const Options& opt, const std::vector<std::string>& args, std::string* output = nullptr) {
+    int pipeFds[2] = {-1, -1};
+    if (output != nullptr && ::pipe(pipeFds) != 0) {
+        throw std::runtime_error("pipe failed");
+    }
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        int null = ::open("/dev/null", O_WRONLY);
+        ::dup2(output != nullptr ? pipeFds[1] : null, STDOUT_FILENO);
+        ::dup2(null, STDERR_FILENO);
+        std::vector<char*> argv{const_cast<char*>(opt.gitlite.c_str())};
+        for (const auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        ::execv(argv[0], argv.data());
+        std::_Exit(127);
+    }
+    if (output != nullptr) {
+        ::close(pipeFds[1]);
+        output->clear();
+        char buf[4096];
+        for (ssize_t n; (n = ::read(pipeFds[0], buf, sizeof(buf))) > 0;) {
+            output->append(buf, static_cast<size_t>(n));
+        }
+        ::close(pipeFds[0]);
+    }
+    int status = 0;
+    rusage usage{};
+    ::wait4(pid, &status, 0, &usage);
+    Sample sample;
+    sample.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    sample.maxRssKb = usage.ru_maxrss; // Linux 上以 KiB 为单位
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error(std::format("gitlite {} failed", args.front()));
+    }
+    return sample;
+}
+
+// gitlite 出错时也以 0 退出，只打印一行消息：生成阶段的命令不应有任何输出
+void must(const Options& opt, const std::vector<std::string>& args) {
+    std::string out;
+    run(opt, args, &out);
+    if (!out.empty()) {
+        throw std::runtime_error(std::format("gitlite {}: {}", args.front(), out));
+    }
+}
+
+class Generator {
+private:
+    const Options& opt;
+    std::mt19937_64 rng;
+    std::string branch = "master";
+
+public:
+    explicit Generator(const Options& options) : opt(options), rng(options.seed) {}
+
+    static std::string file_name(size_t i) { return std::format("d{}/f{}.txt", i / 256, i); }
+    static std::string branch_name(size_t b) { return b == 0 ? "master" : std::format("b{}", b); }
+
+    void write_file(size_t i) {
+        size_t size = opt.size / 2 + rng() % (opt.size + 1);
+        std::string content;
+        while (content.size() < size) {
+            content += std::format("{} {:016x}\n", content.size(), rng());
+        }
+        content.resize(size);
+        auto name = file_name(i);
+        fs::create_directories(fs::path(name).parent_path());
+        std::ofstream(name, std::ios::binary) << content;
+    }
+
+    // 改动分支 b 负责的一个文件（文件按下标对分支数取模分给各分支，合并因此不会冲突）
+    size_t pick(size_t b) {
+        size_t perBranch = (opt.files - b + opt.branches - 1) / opt.branches;
+        return b + (rng() % perBranch) * opt.branches;
+    }
+
+    void checkout(const std::string& name) {
+        if (name != branch) {
+            must(opt, {"checkout", name});
+            branch = name;
+        }
+    }
+
+    void change_and_commit(size_t b, const std::string& message) {
+        for (size_t k = 0; k < opt.changes; ++k) {
+            size_t i = pick(b);
+            write_file(i);
+            must(opt, {"add", file_name(i)});
+        }
+        must(opt, {"commit", message});
+    }
+
+    void generate() {
+        must(opt, {"init"});
+        for (size_t i = 0; i < opt.files; ++i) {
+            write_file(i);
+            must(opt, {"add", file_name(i)});
+        }
+        must(opt, {"commit", "import"});
+        for (size_t b = 1; b < opt.branches; ++b) {
+            must(opt, {"branch", branch_name(b)});
+        }
+        std::vector<size_t> sinceMerge(opt.branches);
+        for (size_t c = 0; c < opt.commits; ++c) {
+            size_t b = c % opt.branches;
+            checkout(branch_name(b));
+            change_and_commit(b, std::format("commit {}", c));
+            if (b != 0 && opt.mergeEvery > 0 && ++sinceMerge[b] % opt.mergeEvery == 0) {
+                checkout("master");
+                run(opt, {"merge", branch_name(b)});
+            }
+        }
+        checkout("master");
+    }
+};
+
+struct Stats {
+    std::vector<Sample> samples;
+
+    void add(const Sample& s) { samples.push_back(s); }
+
+    [[nodiscard]] double percentile(double p) const {
+        std::vector<double> ms;
+        for (const auto& s : samples) {
+            ms.push_back(s.ms);
+        }
+        std::ranges::sort(ms);
+        // 最近秩法
+        auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(ms.size())));
+        return ms[std::max<size_t>(rank, 1) - 1];
+    }
+
+    [[nodiscard]] std::string json(const std::string& command) const {
+        double total = 0;
+        long rss = 0;
+        for (const auto& s : samples) {
+            total += s.ms;
+            rss = std::max(rss, s.maxRssKb);
+        }
+        return std::format(R"({{"command": "{}", "runs": {}, "p50_ms": {:.3f}, "p99_ms": {:.3f}, )"
+                           R"("ops_per_sec": {:.1f}, "peak_rss_kb": {}}})",
+                           command, samples.size(), percentile(0.5), percentile(0.99),
+                           1000.0 * static_cast<double>(samples.size()) / total, rss);
+    }
+};
+
+std::vector<std::string> lines(const std::string& text) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    for (size_t nl; (nl = text.find('\n', start)) != std::string::npos; start = nl + 1) {
+        if (nl > start) {
+            out.push_back(text.substr(start, nl - start));
+        }
+    }
+    return out;
+}
+
+std::map<std::string, Stats> measure(const Options& opt, Generator& gen) {
+    std::map<std::string, Stats> stats;
+    auto time = [&](const std::string& command, const std::vector<std::string>& args) {
+        stats[command].add(run(opt, args));
+    };
+    std::string out;
+    for (size_t r = 0; r < opt.runs; ++r) {
+        time("status", {"status"});
+        time("log", {"log"});
+        time("global-log", {"global-log"});
+        time("find", {"find", std::format("commit {}", opt.commits / 2)});
+    }
+    // add 与 commit：每轮改动 master 的一个文件
+    for (size_t r = 0; r < opt.runs; ++r) {
+        size_t i = gen.pick(0);
+        gen.write_file(i);
+        time("add", {"add", Generator::file_name(i)});
+        time("commit", {"commit", std::format("bench {}", r)});
+    }
+    // checkout：在 master 与第一个侧分支之间往返，两个方向都计时
+    for (size_t r = 0; r < opt.runs; ++r) {
+        time("checkout", {"checkout", Generator::branch_name(1)});
+        time("checkout", {"checkout", "master"});
+    }
+    // reset：退回较早的提交再回到原来的位置
+    run(opt, {"log", "--format=%H", "-n", "10"}, &out);
+    auto ids = lines(out);
+    for (size_t r = 0; r < opt.runs && ids.size() > 1; ++r) {
+        time("reset", {"reset", ids.back()});
+        time("reset", {"reset", ids.front()});
+    }
+    // merge：每轮新建一个分支，两边各提交一次，只对 merge 本身计时
+    for (size_t r = 0; r < opt.runs; ++r) {
+        // 带上进程号：复用的仓库里可能已有之前运行留下的同名分支
+        auto side = std::format("bench-merge-{}-{}", ::getpid(), r);
+        must(opt, {"branch", side});
+        gen.checkout(side);
+        gen.change_and_commit(1, std::format("side {}", r));
+        gen.checkout("master");
+        gen.change_and_commit(0, std::format("main {}", r));
+        time("merge", {"merge", side});
+    }
+    return stats;
+}
+
+Options parse(int argc, char* argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto eq = arg.find('=');
+        auto key = arg.substr(0, eq);
+        auto value = eq == std::string::npos ? std::string() : arg.substr(eq + 1);
+        auto number = [&] { return static_cast<size_t>(std::stoull(value)); };
+        if (key == "--files") {
+            opt.files = number();
+        } else if (key == "--size") {
+            opt.size = number();
+        } else if (key == "--commits") {
+            opt.commits = number();
+        } else if (key == "--branches") {
+            opt.branches = number();
+        } else if (key == "--merge-every") {
+            opt.mergeEvery = number();
+        } else if (key == "--changes") {
+            opt.changes = number();
+        } else if (key == "--runs") {
+            opt.runs = number();
+        } else if (key == "--seed") {
+            opt.seed = number();
+        } else if (key == "--dir") {
+            opt.dir = value;
+        } else if (key == "--keep") {
+            opt.keep = true;
+        } else if (key == "--gitlite") {
+            opt.gitlite = value;
+        } else {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+    }
+    opt.branches = std::max<size_t>(opt.branches, 2);
+    opt.files = std::max(opt.files, opt.branches);
+    opt.runs = std::max<size_t>(opt.runs, 1);
+    if (opt.dir.empty()) {
+        opt.dir = fs::temp_directory_path() / std::format("gitlite_bench_{}", ::getpid());
+    }
+    opt.dir = fs::absolute(opt.dir);
+    opt.gitlite = fs::absolute(opt.gitlite);
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        Options opt = parse(argc, argv);
+        fs::create_directories(opt.dir);
+        fs::current_path(opt.dir);
+
+        Generator gen(opt);
+        double generateMs = 0;
+        bool reused = fs::exists(".gitlite");
+        if (!reused) {
+            auto start = std::chrono::steady_clock::now();
+            gen.generate();
+            generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        auto stats = measure(opt, gen);
+
+        std::cout << "{\n";
+        std::cout << std::format(R"(  "config": {{"files": {}, "size": {}, "commits": {}, "branches": {}, )"
+                                 R"("merge_every": {}, "changes": {}, "runs": {}, "seed": {}}},)",
+                                 opt.files, opt.size, opt.commits, opt.branches, opt.mergeEvery, opt.changes,
+                                 opt.runs, opt.seed)
+                  << '\n';
+        std::cout << std::format(R"(  "reused": {}, "generate_ms": {:.1f},)", reused ? "true" : "false", generateMs) << '\n';
+        std::cout << "  \"results\": [\n";
+        const std::vector<std::string> order{"add", "commit", "log", "global-log", "find",
+                                             "checkout", "reset", "merge", "status"};
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (!stats.contains(order[i])) {
+                continue;
+            }
+            std::cout << "    " << stats[order[i]].json(order[i]) << (i + 1 < order.size() ? ",\n" : "\n");
+        }
+        std::cout << "  ]\n}\n";
+
+        if (!opt.keep) {
+            fs::current_path(opt.dir.parent_path());
+            fs::remove_all(opt.dir);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "gitlite_bench: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
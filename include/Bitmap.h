@@ -0,0 +1,58 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Reachability bitmaps, stored under <git>/bitmaps:
+//   OBJECTS   append-only run of 40-char object ids; an object's index is its bit
+//   xx/yyyy   EWAH-compressed bitmap of every commit and blob reachable from that commit
+// Bitmaps are expanded to plain words in memory, where OR / AND-NOT / test are
+// simple word loops; EWAH (runs of clean words + literal words) is the on-disk form.
+namespace bitmap {
+
+class Bitmap {
+private:
+    std::vector<uint64_t> words;
+
+public:
+    void set(size_t pos);
+    [[nodiscard]] bool test(size_t pos) const;
+    Bitmap& operator|=(const Bitmap& other);
+    Bitmap& and_not(const Bitmap& other); // 去掉 other 中的位
+    [[nodiscard]] size_t count() const;
+    [[nodiscard]] std::vector<size_t> positions() const;
+
+    [[nodiscard]] std::string encode() const;
+    // 数据损坏时抛出 std::invalid_argument
+    [[nodiscard]] static Bitmap decode(std::string_view data);
+};
+
+class ObjectTable {
+private:
+    std::filesystem::path file;
+    std::vector<std::string> ids;
+    std::unordered_map<std::string, size_t> index;
+    size_t saved = 0; // 已写入 OBJECTS 的条目数
+
+public:
+    explicit ObjectTable(const std::filesystem::path& gitDir);
+
+    [[nodiscard]] std::optional<size_t> find(const std::string& id) const;
+    // 已有编号直接返回，否则分配新编号（调用 save 之前只存在于内存中）
+    size_t assign(const std::string& id);
+    [[nodiscard]] const std::string& id(size_t pos) const { return ids[pos]; }
+    [[nodiscard]] size_t size() const { return ids.size(); }
+    // 追加新分配的编号；必须先于引用这些编号的位图写入
+    void save();
+};
+
+} // namespace bitmap
+
+#endif // BITMAP_H
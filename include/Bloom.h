@@ -0,0 +1,51 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bloom filter over the ids in an object store, stored as <git>/OBJECT_FILTER:
+//   capacity  ids the filter was sized for (10 bits each)
+//   added     ids added since it was built
+//   bits      the bit array
+// The filter is only a hint. "Absent" answers come without touching the object store. A false
+// "absent" (a crash between writing an object and its bits, or two processes racing on one byte)
+// only makes the caller write or copy an object it already had. So bits are set in place, with
+// no lock and no fsync. A missing or damaged file turns the filter off: everything "may exist".
+// Object ids are SHA-1 hex, already uniform, so the bit positions come straight from the id.
+namespace bloom {
+
+class Filter {
+private:
+    std::filesystem::path file;
+    std::vector<uint8_t> bits; // 为空表示过滤器不可用
+    uint64_t capacity = 0;
+    uint64_t added = 0;
+
+    // 对 id 的每个哈希调用 f(位序号)
+    template <typename F>
+    void positions(std::string_view id, F&& f) const;
+
+public:
+    Filter() = default;
+    explicit Filter(std::filesystem::path filterFile); // 读入整个过滤器
+
+    // 按 ids 重新建立（先写临时文件再改名），容量留出 ids 数量一倍的余量
+    static void create(const std::filesystem::path& filterFile, const std::vector<std::string>& ids);
+
+    [[nodiscard]] bool enabled() const { return !bits.empty(); }
+    // false 表示一定没有；过滤器不可用时总是 true
+    [[nodiscard]] bool may_contain(std::string_view id) const;
+    // 同时更新内存与文件中的位；只改动原先为 0 的字节
+    void add(const std::vector<std::string>& ids);
+    // 加入的 id 超过容量，误判率开始上升，应当重建
+    [[nodiscard]] bool full() const { return enabled() && added > capacity; }
+};
+
+} // namespace bloom
+
+#endif // BLOOM_H
@@ -0,0 +1,65 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Utils.h"
+
+// A bundle is one sequential file:
+//   magic, header (branch, tip, prerequisites, flags),
+//   object records (kind, id, method, raw size, payload) ..., end marker,
+//   40-char SHA-1 of everything before it.
+// Records use the same length-prefixed encoding as ser::serialize.
+namespace bundle {
+
+enum class ObjectKind : uint8_t { End = 0, Blob = 'b', Commit = 'c' };
+
+struct Header {
+    std::string branch;
+    std::string tip;
+    std::vector<std::string> prerequisites; // 接收方必须已有的提交
+    bool compressed = false;
+};
+
+class Writer {
+private:
+    std::ofstream file;
+    SHA1::Context ctx;
+    bool compressed;
+    std::vector<char> buffer;
+    void put(std::string_view bytes);
+
+public:
+    Writer(const std::filesystem::path& target, const Header& header);
+    void add(ObjectKind kind, std::string_view id, std::string_view content);
+    void finish();
+};
+
+class Reader {
+private:
+    std::ifstream file;
+    SHA1::Context ctx;
+    Header head;
+    std::vector<char> buffer;
+    std::streamoff remaining = 0; // 文件中尚未读取的字节数
+    void get(char* dst, size_t n);
+    size_t get_size();
+    std::string get_string();
+
+public:
+    explicit Reader(const std::filesystem::path& source);
+    [[nodiscard]] const Header& header() const { return head; }
+    // 读出下一个对象，到达结尾标记时返回 false
+    bool next(ObjectKind& kind, std::string& id, std::string& content);
+    // 必须在 next 返回 false 之后调用
+    bool verify();
+};
+
+} // namespace bundle
+
+#endif // BUNDLE_H
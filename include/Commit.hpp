@@ -4,6 +4,7 @@
 #include "Serialization.hpp"
 #include <chrono>
 #include <map>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -22,14 +23,24 @@ struct Commit {
     return Commit("initial commit", std::chrono::system_clock::time_point{});
 }
 
-inline void serialize(const Commit& obj, std::ostream& out) {
-    ser::serialize(obj.id, out);
+// 除 ID 与文件映射以外的字段；文件映射紧随其后，可由调用方另行写出
+inline void serialize_header_body(const Commit& obj, std::ostream& out) {
     ser::serialize(obj.message, out);
     ser::serialize(obj.parents, out);
     ser::serialize(obj.timestamp, out);
+}
+
+// 除 ID 以外的字段，也就是提交 ID 所哈希的内容
+inline void serialize_body(const Commit& obj, std::ostream& out) {
+    serialize_header_body(obj, out);
     ser::serialize(obj.mapping, out);
 }
 
+inline void serialize(const Commit& obj, std::ostream& out) {
+    ser::serialize(obj.id, out);
+    serialize_body(obj, out);
+}
+
 inline void deserialize(Commit& obj, std::istream& in) {
     ser::deserialize(obj.id, in);
     ser::deserialize(obj.message, in);
@@ -38,13 +49,22 @@ inline void deserialize(Commit& obj, std::istream& in) {
     ser::deserialize(obj.mapping, in);
 }
 
-[[nodiscard]] inline std::string serialize(const Commit& obj) {
-    std::string all;
-    all.append(ser::serialize(obj.message));
-    all.append(ser::serialize(obj.parents));
-    all.append(ser::serialize(obj.timestamp));
-    all.append(ser::serialize(obj.mapping));
-    return all;
+// mapping 位于提交对象的末尾：历史类命令（log、find、合并基点搜索）只需要前四个字段，
+// 读到时间戳即可停止，文件映射既不解码也不会被整体读入
+inline void deserialize_header(Commit& obj, std::istream& in) {
+    ser::deserialize(obj.id, in);
+    ser::deserialize(obj.message, in);
+    ser::deserialize(obj.parents, in);
+    ser::deserialize(obj.timestamp, in);
+    obj.mapping.clear();
+}
+
+inline void deserialize_header_from_file(Commit& obj, const std::filesystem::path& target) {
+    std::ifstream file(target, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::invalid_argument("cannot open file");
+    }
+    deserialize_header(obj, file);
 }
 
 #endif // COMMIT_H
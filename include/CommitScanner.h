@@ -0,0 +1,39 @@
+#ifndef COMMIT_SCANNER_H
+#define COMMIT_SCANNER_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Commit.hpp"
+
+// Whole-repository commit scans (global-log, find fallbacks, index rebuilds).
+// Commit files are decoded and rendered by a pool of workers one batch at a time;
+// the results are then handed to the caller strictly in input order, so output is
+// identical to a serial scan whatever the thread count.
+namespace scan {
+
+// GITLITE_JOBS 环境变量指定的线程数，未设置或非法时取硬件线程数
+[[nodiscard]] unsigned default_jobs();
+
+// 用 jobs 个线程对 [0, count) 的每个下标调用 body(index, worker)，worker 取值 [0, jobs)。
+// 下标按需领取；任一调用抛出异常时停止分发，等全部线程结束后在调用线程重新抛出
+void parallel_for(size_t count, unsigned jobs, const std::function<void(size_t index, unsigned worker)>& body);
+
+enum class Decode { Header, Full }; // Header 只解码 id、消息、父提交与时间戳
+
+using renderer = std::function<std::string(Commit& comm)>;           // 在工作线程中调用
+// 在调用线程中按顺序调用；返回 false 时停止扫描（不再启动新的批次）
+using emitter = std::function<bool(size_t index, std::string& text)>;
+
+void for_each_commit(const std::vector<std::filesystem::path>& files,
+                     unsigned jobs,
+                     const renderer& render,
+                     const emitter& emit,
+                     Decode decode);
+
+} // namespace scan
+
+#endif // COMMIT_SCANNER_H
@@ -0,0 +1,46 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Line-level diff: lines are interned to integers, the common prefix and suffix
+// are trimmed, and the rest is compared with Myers' linear-space O(ND) algorithm.
+namespace diff {
+
+// a[aPos, aPos + aLen) 被替换为 b[bPos, bPos + bLen)，两段之间的行完全相同
+struct Chunk {
+    size_t aPos;
+    size_t aLen;
+    size_t bPos;
+    size_t bLen;
+};
+
+// 按行切分，每行保留结尾的 '\n'（最后一行可能没有）
+[[nodiscard]] std::vector<std::string_view> split_lines(std::string_view text);
+
+[[nodiscard]] std::vector<Chunk> diff_lines(const std::vector<std::string_view>& a,
+                                            const std::vector<std::string_view>& b);
+
+[[nodiscard]] bool is_binary(std::string_view text);
+
+// 以统一格式（unified diff）追加到 out；aName/bName 形如 "a/f.txt" 或 "/dev/null"
+void unified(std::string& out,
+             std::string_view aName,
+             std::string_view bName,
+             std::string_view a,
+             std::string_view b,
+             size_t context = 3);
+
+// 整个文件作为一个冲突块：<<<<<<< HEAD / a / ======= / b / >>>>>>>
+void append_conflict(std::string& out, std::string_view a, std::string_view b);
+
+// 以 base 为共同祖先对 a、b 做逐行三方合并，结果追加到 out。
+// 只改动一侧或两侧改动相同的区域直接合入，真正重叠的区域写入冲突块；存在冲突时返回 false。
+bool merge3(std::string_view base, std::string_view a, std::string_view b, std::string& out);
+
+} // namespace diff
+
+#endif // DIFF_H
@@ -0,0 +1,81 @@
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Crash-safe file replacement.
+// Every write goes to a temporary file next to its target and is renamed over it,
+// so readers (and a crash) see either the old or the new contents, never a torn file.
+// How much is flushed to disk is chosen by GITLITE_FSYNC:
+//   none    no flushing; only the rename is relied on
+//   batch   (default) one syncfs round per Transaction, before its renames;
+//           writes outside a transaction are only renamed atomically
+//   full    every file and its directory are flushed
+namespace durable {
+
+enum class Mode { None, Batch, Full };
+
+// GITLITE_FSYNC 环境变量，未设置或无法识别时为 Batch
+[[nodiscard]] Mode mode();
+
+using writer = std::function<void(std::ostream& out)>;
+
+// 把文件已写入的内容刷到磁盘（fsync）
+void sync_file(const std::filesystem::path& file);
+
+// 与 target 同目录的临时文件名（含进程号，避免并发写入互相覆盖）
+[[nodiscard]] std::filesystem::path temp_path(const std::filesystem::path& target);
+
+// 写好的临时文件改名为 target：按模式落盘；事务进行中则推迟到提交时
+void publish(const std::filesystem::path& tmp, const std::filesystem::path& target);
+
+void write_file(const std::filesystem::path& target, const writer& write);
+void write_file(const std::filesystem::path& target, std::string_view content);
+
+// 一次操作的全部写入先落在临时文件里，commit 时统一同步一次再依次改名（按写入顺序，
+// 调用方应让引用类文件最后写入）。事务内的写入在提交前对读取不可见。
+// 嵌套的事务并入最外层；以 std::exit 结束的命令在退出时自动提交；
+// 未提交就析构（异常）时丢弃临时文件，目标文件保持原样。
+class Transaction {
+private:
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> staged; // (临时文件, 目标)
+    bool outer = false;
+
+    friend void publish(const std::filesystem::path& tmp, const std::filesystem::path& target);
+
+public:
+    Transaction();
+    ~Transaction();
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+    void commit();
+};
+
+// 独占锁 <target>.lock（O_CREAT | O_EXCL 创建）。新内容写进锁文件，commit 时改名覆盖
+// target 并同时释放锁；事务进行中则锁一直持有到事务提交。锁被占用时退避重试，
+// 超时抛出 GitliteException。release 只释放锁、不改动 target（锁仅用作互斥时）。
+class FileLock {
+private:
+    std::filesystem::path target;
+    std::filesystem::path lock;
+    bool held = false;
+
+public:
+    explicit FileLock(std::filesystem::path file);
+    ~FileLock();
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    void commit(const writer& write);
+    void release();
+};
+
+} // namespace durable
+
+#endif // DURABLE_H
@@ -2,6 +2,9 @@
 #define GITENGINE_H
 
 #include "Repository.h"
+#include <chrono>
+#include <optional>
+#include <vector>
 
 class GitEngine {
     using con_string = const std::string&;
@@ -11,6 +14,7 @@ private:
 
 public:
     void init();
+    void clone(con_string source, con_string directory, int depth, bool blobless, bool shared);
 
     void addRemote(con_string name, con_string path);
     void rmRemote(con_string name);
@@ -19,10 +23,12 @@ public:
     void commit(con_string message);
     void rm(con_string filename);
 
-    void log();
-    void globalLog();
+    void log(const LogOptions& options);
+    void globalLog(const LogOptions& options);
     void find(con_string message);
+    void findGrep(con_string pattern);
     void status();
+    void diff(const std::vector<std::string>& revs, bool cached);
 
     void checkoutBranch(con_string branch);
     void checkoutFile(con_string filename);
@@ -36,6 +42,17 @@ public:
     void push(con_string remoteName, con_string remoteBranch);
     void fetch(con_string remoteName, con_string remoteBranch);
     void pull(con_string remoteName, con_string remoteBranch);
+
+    void bundleCreate(con_string file, con_string branch, const std::optional<std::string>& base, bool compress);
+    void unbundle(con_string file);
+
+    void bitmap();
+    void packRefs();
+    void sparseSet(const std::vector<std::string>& dirs);
+    void sparseList();
+    void sparseDisable();
+    void gc(std::chrono::system_clock::time_point expire);
+    void fsck(bool quick);
 };
 
 #endif // GITENGINE_H
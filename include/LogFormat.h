@@ -0,0 +1,76 @@
+#ifndef LOG_FORMAT_H
+#define LOG_FORMAT_H
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "Commit.hpp"
+
+// Fast output path for log and global-log.
+//   OutBuffer       one large stdout buffer, flushed with write(2)
+//   DateFormatter   time zone resolved once; offset reused while it stays valid,
+//                   calendar part cached per local day and the whole string per second
+//   CommitFormatter a log format compiled once into literal/placeholder pieces
+namespace logfmt {
+
+class OutBuffer {
+private:
+    std::string buf;
+
+public:
+    OutBuffer();
+    ~OutBuffer();
+    OutBuffer(const OutBuffer&) = delete;
+    OutBuffer& operator=(const OutBuffer&) = delete;
+
+    std::string& data() { return buf; }
+    // 缓冲区足够大时才真正写出
+    void maybe_flush();
+    void flush();
+};
+
+class DateFormatter {
+private:
+    const std::chrono::time_zone* zone;
+    std::chrono::sys_seconds infoBegin{};
+    std::chrono::sys_seconds infoEnd{};
+    std::chrono::seconds offset{0};
+    std::string offsetText;             // "+0800"
+    std::chrono::sys_days day{};        // 已缓存的本地日期
+    std::string dayPrefix;              // "Thu Jan 01 "
+    std::string yearSuffix;             // " 1970 "
+    std::chrono::sys_seconds second{};  // 已缓存的整秒
+    std::string text;
+    bool primed = false;
+
+public:
+    DateFormatter();
+    // 形如 "Thu Jan 01 08:00:00 1970 +0800"（不含 "Date: "）
+    const std::string& format(std::chrono::system_clock::time_point tp);
+};
+
+class CommitFormatter {
+private:
+    enum class Piece { Literal, Id, ShortId, Parents, ShortParents, Subject, Body, Date, UnixTime, MergeLine };
+    std::vector<std::pair<Piece, std::string>> pieces;
+
+    explicit CommitFormatter(std::vector<std::pair<Piece, std::string>> p) : pieces(std::move(p)) {}
+
+public:
+    // 默认的 "===" 分隔格式
+    static CommitFormatter standard();
+    // "<7 位 ID> <消息首行>"
+    static CommitFormatter oneline();
+    // %H %h %P %p %s %B %ad %at %n %%，每个提交以换行结束
+    static CommitFormatter parse(std::string_view format);
+
+    // 可在多个线程中同时调用：每个线程使用自己的 DateFormatter
+    void append(std::string& out, const Commit& comm) const;
+};
+
+} // namespace logfmt
+
+#endif // LOG_FORMAT_H
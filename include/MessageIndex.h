@@ -0,0 +1,37 @@
+#ifndef MESSAGE_INDEX_H
+#define MESSAGE_INDEX_H
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Commit-message index under <git>/msgindex, laid out like the object store:
+//   exact/xx/yyyy...  ids of commits whose message has that SHA-1
+//   tri/xx/yyyy       ids of commits whose message contains that byte trigram (hex)
+// Posting files are append-only runs of 40-char ids, so adding a commit never
+// rewrites existing data. Readers tolerate duplicates.
+class MessageIndex {
+private:
+    std::filesystem::path root;
+
+    [[nodiscard]] std::vector<std::string> postings(const std::filesystem::path& file) const;
+
+public:
+    explicit MessageIndex(const std::filesystem::path& gitDir);
+
+    [[nodiscard]] bool exists() const;
+    void create() const;
+    // (id, message) 对，按文件聚合后每个倒排文件只追加一次
+    void add(const std::vector<std::pair<std::string, std::string>>& entries) const;
+
+    // 消息完全相同的提交，按 ID 排序
+    [[nodiscard]] std::vector<std::string> exact(std::string_view message) const;
+    // 正则中必然出现的字面量所对应的候选提交（仍需逐个验证）；
+    // 无法从模式中提取三元组时返回 nullopt，调用方应退回全量扫描
+    [[nodiscard]] std::optional<std::vector<std::string>> candidates(std::string_view pattern) const;
+};
+
+#endif // MESSAGE_INDEX_H
@@ -0,0 +1,39 @@
+#ifndef REFS_H
+#define REFS_H
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Branch refs of one .gitlite directory:
+//   refs/heads/<name>   loose ref (a serialized commit id); every update writes one of these
+//   packed-refs         "<id> <name>\n" lines sorted by name, written by `gitlite pack-refs`
+// A loose ref overrides the packed line of the same name. Lookups binary-search packed-refs
+// by byte offset and only read a handful of lines, so the cost grows with log n, not n.
+class RefStore {
+private:
+    std::filesystem::path git;
+
+    [[nodiscard]] std::filesystem::path packed_file() const { return git / "packed-refs"; }
+    [[nodiscard]] std::map<std::string, std::string> read_all_packed() const;
+
+public:
+    explicit RefStore(std::filesystem::path gitDir) : git(std::move(gitDir)) {}
+
+    [[nodiscard]] std::filesystem::path loose_path(std::string_view name) const;
+    [[nodiscard]] std::optional<std::string> read(std::string_view name) const;
+    [[nodiscard]] std::optional<std::string> read_packed(std::string_view name) const;
+    [[nodiscard]] bool exists(std::string_view name) const { return read(name).has_value(); }
+    // 全部分支：名称到提交 ID，按名称排序
+    [[nodiscard]] std::map<std::string, std::string> list() const;
+
+    // 删除分支：松散引用与 packed-refs 中的记录都删除
+    void remove(std::string_view name);
+    // 把松散引用并入 packed-refs，返回并入的个数；并入期间被改动的松散引用保留
+    size_t pack();
+};
+
+#endif // REFS_H
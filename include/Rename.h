@@ -0,0 +1,32 @@
+#ifndef RENAME_H
+#define RENAME_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Rename detection between two path -> blob id maps.
+// Exact blob-id matches are paired first; the remaining files are compared through
+// MinHash signatures of their line hashes, and LSH banding picks the candidate pairs,
+// so only files that share a band are ever scored.
+namespace diff {
+
+struct RenamePair {
+    std::string from;
+    std::string to;
+    int score; // 相似度 0-100
+};
+
+using blob_loader = std::function<std::string(const std::string& name, const std::string& id)>;
+
+// deleted: 消失的路径；added: 新出现的路径。每个被删除的文件最多成为一次重命名来源。
+[[nodiscard]] std::vector<RenamePair> detect_renames(const std::map<std::string, std::string>& deleted,
+                                                     const std::map<std::string, std::string>& added,
+                                                     const blob_loader& loadSource,
+                                                     const blob_loader& loadTarget,
+                                                     int minScore = 50);
+
+} // namespace diff
+
+#endif // RENAME_H
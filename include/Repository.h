@@ -1,14 +1,34 @@
 #ifndef REPOSITORY_H
 #define REPOSITORY_H
 
+#include <chrono>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <optional>
 #include <set>
 #include <string>
 #include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
+#include "Bitmap.h"
+#include "Bloom.h"
 #include "Commit.hpp"
+#include "Refs.h"
+#include "Sparse.h"
+
+// log / global-log 的输出与范围选项
+struct LogOptions {
+    bool oneline = false;
+    std::optional<std::string> format;                          // --format=<fmt>
+    std::optional<size_t> limit;                                // -n N
+    std::optional<std::chrono::system_clock::time_point> since; // --since=<date>
+    std::optional<std::chrono::system_clock::time_point> until; // --until=<date>
+    std::optional<std::string> range;                           // <rev> 或 A..B（仅 log）
+};
+
 class Repo {
     using path = std::filesystem::path;
     using string = std::string;
@@ -21,51 +41,180 @@ private:
     static const path branchDir;
     static const path headFile;
     static const path indexFile;
+    static const path indexDeltaFile;
     static const path commitSetFile;
-    static const path branchSetFile;
+    static const path remoteSetFile;
+    static const path shallowFile;
+    static const path promisorFile;
+    static const path alternatesFile;
+    static const path objectFilterFile;
+    static const path sparseFile;
+    static const path sparseIndexFile;
+    static const path sparseTreeDir;
+    static const path untrackedFile;
+    static const path statFile;
 
     string headCommitId;               // 当前 HEAD 提交的 Commit ID
     string headBranch;                 // 当前所在的分支名
     std::map<string, string> branches; // refs/heads 的内容
     std::map<string, string> stageAdd; // 暂存区待添加的内容
     std::set<string> stageRemove;      // 暂存区待删除的内容
+    size_t indexDelta = 0;             // INDEX_DELTA 中尚未并入 INDEX1/INDEX2 的记录数
+    std::optional<durable::FileLock> indexLock; // INDEX.lock，取得后持有到命令结束
     std::set<string> allCommits;       // 所有提交的 ID 集合
-    std::set<string> allBranches;       // 所有分支的名称集合
+    RefStore refs{gitDir};              // 分支引用：松散引用优先，其次 packed-refs
+    std::map<string, string> remotes;   // 远程名称到远程 .gitlite 目录的映射
+    std::set<string> shallow;           // 浅克隆边界：这些提交的父提交不在本地
+    std::optional<path> promisor;       // 部分克隆时可按需取回缺失 blob 的仓库
+    std::optional<sparse::Cone> cone;   // 稀疏检出范围，首次用到时读取 SPARSE
+    std::optional<sparse::Index> sindex; // 稀疏索引，与 HEAD 或稀疏模式不符时重建
 
     static path id_to_dir(string_view id);
-    static void add_commit(const Commit& comm);                         // 向 objects 加入提交
-    static void update_branch(string_view branch, string_view comm_id); // 向 refs/heads 写入分支信息
+    static path id_to_dir(const path& git, string_view id); // 以任意 .gitlite 目录为根
+    // ALTERNATES 中列出的其他对象目录：本地缺少的对象从这里读取
+    static const std::vector<path>& alternates(const path& git);
+    // 读取用的对象路径：本地没有时依次查找 alternates，都没有时返回本地路径；写入仍用 id_to_dir
+    static path find_object(const path& git, string_view id);
+    // OBJECT_FILTER（各仓库读取一次）；可以整体赋值以换成重建后的过滤器
+    static bloom::Filter& object_filter(const path& git);
+    // 对象是否存在（含 alternates）：过滤器判定没有时不 stat。可能误答没有，
+    // 因此只用来省掉写入与复制；结果影响命令语义的检查仍用 fs::exists(find_object(...))
+    static bool has_object(const path& git, string_view id);
+    // 新写入的对象记入过滤器；加入过多时重建，对象目录之外还包括本进程记入过的 ID（事务中尚未落盘）
+    static void record_objects(const path& git, const std::vector<string>& ids);
+    static std::vector<string> list_objects(const path& git); // objects 目录中全部对象的 ID
+    // 计算并填入提交 ID，向 objects 加入提交；给出 mapping 时由它写出文件映射，comm.mapping 不使用
+    static string add_commit(Commit& comm, const durable::writer& mapping = nullptr);
+    // 事务提交之后登记新提交：追加到 COMMITS 并索引消息。只追加不改写，
+    // 调用者无需（也不应）载入 allCommits
+    void record_commit(con_string id, con_string message);
+    // 完整解码提交对象的字节：ID 字段等于 id 且没有多余字节；rehash 时还要求其余字节的 SHA-1 等于 id
+    static bool decode_commit(const string& bytes, string_view id, Commit& comm, bool rehash = true);
+    // 比较并交换：持有松散引用的锁时重读当前值（含 packed-refs），与 expected 不符（"" 表示引用尚不存在）
+    // 则不写入并返回 false；不给 expected 时无条件写入
+    static bool update_ref(const path& git,
+                           string_view name,
+                           string_view comm_id,
+                           const std::optional<string>& expected = std::nullopt);
+    // 向 refs/heads 写入分支信息；比较失败（被其他进程抢先移动）时抛出 GitliteException
+    static void update_branch(string_view branch,
+                              string_view comm_id,
+                              const std::optional<string>& expected = std::nullopt);
     static void update_head(string_view branch);                        // 向 HEAD 写入头信息
 
     void add_init_commit(); // 向 objects 加入初始提交
+    static void create_layout();
 
     void recover_basic_info();
+    // 修改暂存区的命令在 recover_index 之前调用：从读取到追加或重写期间持有 INDEX.lock，
+    // 其他进程追加的记录不会被这次重写覆盖掉。只读的命令不取锁
+    void lock_index();
     void recover_index();
+    void persist_index(); // 重写 INDEX1/INDEX2 并清空 INDEX_DELTA
+    // 暂存区的一次改动只追加一条记录到 INDEX_DELTA；记录积累过多时改为 persist_index
+    //   'A' path blob：暂存 path；'U' path：取消 path 的暂存；'R' path：暂存 path 的删除
+    void append_index(char op, con_string fileName, string_view blobId = {});
     void recover_commit_set();
     void persist_commit_set();
-    void recover_branch_set();
-    void persist_branch_set();
+    void recover_remote_set();
+    void persist_remote_set();
+    void recover_shallow_set();
+
+    path ensure_object(string_view id); // 对象缺失时从 promisor 按需取回，promisor 也没有时抛出 GitliteException
+
+    // 工作区读写：稀疏检出范围之外的路径不写出、不检查
+    const sparse::Cone& sparse_cone();
+    void write_worktree(con_string name, con_string blobId);
+    static void remove_worktree(con_string name); // 连同删空的上级目录
+    // 经由未跟踪缓存访问工作区（稀疏范围内）的每个文件
+    void scan_worktree(const std::function<void(const string& path)>& visit);
+    void check_untracked(const Commit& src, const Commit& dst);
+    void apply_sparse(const sparse::Cone& next);
+    sparse::Index& sparse_index(); // 仅在启用稀疏检出时使用
 
-    static Commit merge_base(Commit A, Commit B);
+    // 提交消息索引：只在索引已建立时增量追加，缺失时由 find 整体重建
+    static void index_messages(const path& git, const std::vector<std::pair<string, string>>& entries);
+    void rebuild_message_index();
+    static std::vector<path> commit_files(const std::set<string>& ids); // 全量扫描的输入，顺序与 ids 一致
+
+    Commit merge_base(Commit A, Commit B);
+    // 写入对象库；write 为 false 时（稀疏范围之外且无冲突）不写工作区
+    static string store_merged(con_string fileName, const string& content, bool write = true);
+
+    // 可达性位图：从 starts 出发把可达的提交（withBlobs 时连同 blob）并入 bm，
+    // 遇到已存位图的提交直接按位或，不再向下遍历。给出 stop 时，该位一经置上立即停止并返回 true
+    // （此时 bm 不完整）；否则返回 false
+    bool reach_into(bitmap::Bitmap& bm,
+                    bitmap::ObjectTable& table,
+                    const std::vector<string>& starts,
+                    bool withBlobs,
+                    std::optional<size_t> stop = std::nullopt);
+    static path bitmap_file(string_view id);
+    // gc 的标记阶段：逐层并行读取提交，返回从 commits 可达的全部提交与 blob
+    std::unordered_set<string> mark_reachable(const std::vector<string>& commits, unsigned jobs);
+
+    // 远程传输：协商出对方缺少的对象，只复制这些对象
+    bool in_history(string_view tip, string_view ancestor);
+    static std::vector<Commit> missing_commits(const path& srcGit,
+                                               string_view tip,
+                                               const std::function<bool(const string&)>& have,
+                                               std::unordered_set<string>& haveBlobs);
+    // link 时以硬链接或 reflink 共享对象文件（本地克隆）
+    static void copy_objects(const path& srcGit, const path& dstGit, std::vector<string> ids, bool link = false);
+    static void transfer_objects(const path& srcGit,
+                                 const path& dstGit,
+                                 const std::vector<Commit>& commits,
+                                 std::unordered_set<string>& haveBlobs);
+    path remote_git_dir(con_string name);
+
+    std::optional<string> resolve_commit(con_string rev); // 分支名或（缩写的）提交 ID
+    // 按时间戳从新到旧访问 include 可达、exclude 不可达的提交；visit 返回 false 时停止
+    void walk_range(con_string include, con_string exclude, const std::function<bool(const Commit&)>& visit);
 
     std::optional<string> get_id_blob_id(const string& fileName);
 
+    using content_loader = std::function<string(const string& name, const string& id)>;
+    // 按路径归并比较两个映射，blob ID 相同的文件不读取内容
+    static void diff_mappings(const std::map<string, string>& from,
+                              const std::map<string, string>& to,
+                              const content_loader& loadFrom,
+                              const content_loader& loadTo,
+                              string& out);
+
 public:
     void init(); // 初始化仓库
     void git_add(con_string fileName);
     void git_commit(con_string message);
     void git_rm(con_string fileName);
-    void git_log();
-    void global_log();
+    void git_log(const LogOptions& options);
+    void global_log(const LogOptions& options);
     void find(con_string message);
+    void find_grep(con_string pattern);
     void checkout_branch(con_string branch);
     void checkout_file(con_string fileName);
     void checkout_file_in_commit(con_string commitId, con_string fileName);
     void status();
+    void diff(const std::vector<string>& revs, bool cached);
     void branch(con_string name);
     void rm_branch(con_string name);
     void reset(con_string commitId);
     void merge(con_string branch);
+    void add_remote(con_string name, con_string remotePath);
+    void rm_remote(con_string name);
+    void push(con_string remoteName, con_string remoteBranch);
+    void fetch(con_string remoteName, con_string remoteBranch);
+    void pull(con_string remoteName, con_string remoteBranch);
+    void bundle_create(con_string file, con_string branch, const std::optional<string>& base, bool compress);
+    void bundle_unbundle(con_string file);
+    void build_bitmaps();
+    void pack_refs(); // 把松散的分支引用并入 packed-refs
+    void sparse_set(const std::vector<string>& dirs);
+    void sparse_disable();
+    void sparse_list();
+    void gc(std::chrono::system_clock::time_point expire); // 只删除修改时间早于 expire 的不可达对象
+    void fsck(bool quick); // quick 时不重算 blob 的哈希
+    // shared 时不复制对象，写入 ALTERNATES 借用源仓库的对象目录
+    void clone(con_string source, con_string directory, int depth, bool blobless, bool shared);
 };
 
 #endif // REPOSITORY_H
@@ -1,16 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <set>
 #include <string>
+#include <streambuf>
 #include <string_view>
 #include <type_traits>
 #include <vector>
 
+#include "Durable.h"
+
 namespace ser {
 
 // base case
@@ -39,11 +45,21 @@ inline void serialize(std::string_view obj, std::ostream& out) {
     out.write(obj.data(), static_cast<std::streamsize>(len));
 }
 
+// 长度来自文件本身：损坏的对象可能给出任意大的值，因此分块读取，
+// 流提前结束时停止（failbit 置位），而不是一次 resize 到声明的长度
+inline constexpr size_t READ_CHUNK = size_t{1} << 16;
+
 inline void deserialize(std::string& obj, std::istream& in) {
-    size_t len;
+    size_t len = 0;
     deserialize(len, in);
-    obj.resize(len);
-    in.read(obj.data(), static_cast<std::streamsize>(len));
+    obj.clear();
+    while (in && obj.size() < len) {
+        size_t start = obj.size();
+        size_t n = std::min(len - start, READ_CHUNK);
+        obj.resize(start + n);
+        in.read(obj.data() + start, static_cast<std::streamsize>(n));
+        obj.resize(start + static_cast<size_t>(in.gcount()));
+    }
 }
 
 [[nodiscard]] inline std::string serialize(std::string_view obj) {
@@ -92,10 +108,10 @@ template <typename K, typename V>
         deserialize(v, std::declval<std::istream&>());
     }
 void deserialize(std::map<K, V>& obj, std::istream& in) {
-    size_t len;
+    size_t len = 0;
     deserialize(len, in);
     obj.clear();
-    for (size_t i = 0; i < len; ++i) {
+    for (size_t i = 0; i < len && in; ++i) {
         K k;
         V v;
         deserialize(k, in);
@@ -134,11 +150,11 @@ void serialize(const std::vector<T>& obj, std::ostream& out) {
 template <typename T>
     requires requires(T x) { deserialize(x, std::declval<std::istream&>()); }
 void deserialize(std::vector<T>& obj, std::istream& in) {
-    size_t len;
+    size_t len = 0;
     deserialize(len, in);
     obj.clear();
-    obj.reserve(len);
-    for (size_t i = 0; i < len; ++i) {
+    obj.reserve(std::min(len, READ_CHUNK / sizeof(T)));
+    for (size_t i = 0; i < len && in; ++i) {
         T t;
         deserialize(t, in);
         obj.push_back(std::move(t));
@@ -171,10 +187,10 @@ void serialize(const std::set<T>& obj, std::ostream& out) {
 template <typename T>
     requires requires(T x) { deserialize(x, std::declval<std::istream&>()); }
 void deserialize(std::set<T>& obj, std::istream& in) {
-    size_t len;
+    size_t len = 0;
     deserialize(len, in);
     obj.clear();
-    for (size_t i = 0; i < len; ++i) {
+    for (size_t i = 0; i < len && in; ++i) {
         T t;
         deserialize(t, in);
         obj.insert(std::move(t));
@@ -193,6 +209,45 @@ template <typename T>
     return all;
 }
 
+// 分流输出：缓冲区写满（或 flush）时把这一块依次交给每个接收端——哈希上下文、文件、压缩器等。
+// 同一份序列化结果只编码一次，也不必先拼成完整的字符串
+class sink_buf : public std::streambuf {
+public:
+    using sink = std::function<void(std::string_view chunk)>;
+
+    explicit sink_buf(std::vector<sink> s) : sinks(std::move(s)) {
+        setp(buf.data(), buf.data() + buf.size());
+    }
+    ~sink_buf() override { sync(); }
+    sink_buf(const sink_buf&) = delete;
+    sink_buf& operator=(const sink_buf&) = delete;
+
+protected:
+    int_type overflow(int_type ch) override {
+        sync();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        std::string_view chunk(pbase(), static_cast<size_t>(pptr() - pbase()));
+        if (!chunk.empty()) {
+            for (const auto& s : sinks) {
+                s(chunk);
+            }
+        }
+        setp(buf.data(), buf.data() + buf.size());
+        return 0;
+    }
+
+private:
+    std::vector<sink> sinks;
+    std::array<char, 8192> buf{};
+};
+
 // file operations about serialization
 template <typename T>
     requires requires(T x) { serialize(x, std::declval<std::ostream&>()); }
@@ -200,21 +255,62 @@ void serialize_to_file(const T& obj, const std::filesystem::path& target) {
     auto parent = target.parent_path();
     std::filesystem::create_directories(parent);
 
-    std::ofstream file(target, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::invalid_argument("cannot create file");
-    }
-    serialize(obj, file);
+    durable::write_file(target, [&obj](std::ostream& out) { serialize(obj, out); });
 }
 
 template <typename T>
     requires requires(T x) { serialize(x, std::declval<std::ostream&>()); }
 void serialize_to_safe_file(const T& obj, const std::filesystem::path& target) {
-    std::ofstream file(target, std::ios::binary);
+    durable::write_file(target, [&obj](std::ostream& out) { serialize(obj, out); });
+}
+
+// append elements to a serialized set: patch the leading length, write only the new elements.
+// <target>.lock is held throughout, so concurrent appenders never lose each other's elements.
+template <typename T>
+    requires requires(T x) { serialize(x, std::declval<std::ostream&>()); }
+void append_to_set_file(const std::vector<T>& items, const std::filesystem::path& target) {
+    durable::FileLock lock(target);
+    if (!std::filesystem::exists(target)) {
+        std::set<T> all(items.begin(), items.end());
+        lock.commit([&all](std::ostream& out) { serialize(all, out); });
+        return;
+    }
+    std::fstream file(target, std::ios::binary | std::ios::in | std::ios::out);
     if (!file.is_open()) {
         throw std::invalid_argument("cannot open file");
     }
-    serialize(obj, file);
+    size_t len;
+    deserialize(len, file);
+    // 先追加元素再改长度：中途崩溃时旧长度仍然有效，多出的尾部不会被读到
+    file.seekp(0, std::ios::end);
+    for (const auto& i : items) {
+        serialize(i, file);
+    }
+    file.flush();
+    if (durable::mode() != durable::Mode::None) {
+        durable::sync_file(target);
+    }
+    len += items.size();
+    file.seekp(0, std::ios::beg);
+    serialize(len, file);
+}
+
+// read-modify-write under <target>.lock: the file is re-read after locking, so an update
+// made by another process since the caller last looked is kept rather than overwritten
+template <typename T>
+    requires requires(T x) {
+        serialize(x, std::declval<std::ostream&>());
+        deserialize(x, std::declval<std::istream&>());
+    }
+void update_file(const std::filesystem::path& target, const std::function<void(T& obj)>& modify) {
+    durable::FileLock lock(target);
+    T obj{};
+    if (std::filesystem::exists(target)) {
+        std::ifstream file(target, std::ios::binary);
+        deserialize(obj, file);
+    }
+    modify(obj);
+    lock.commit([&obj](std::ostream& out) { serialize(obj, out); });
 }
 
 template <typename T>
@@ -0,0 +1,77 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <vector>
+
+// Cone-mode sparse checkout. Each pattern names a directory ("src/lib"); a path is in the cone when
+//   - it is a top-level file,
+//   - it lies anywhere under a pattern directory, or
+//   - it is a file directly inside an ancestor of a pattern directory ("src/README" for "src/lib").
+// Patterns live in a trie of path components, so a lookup walks the path once, whatever the
+// number of patterns. An empty cone (sparse checkout disabled) contains every path.
+namespace sparse {
+
+class Cone {
+private:
+    struct Node {
+        std::map<std::string, size_t, std::less<>> children; // 子目录名 -> nodes 下标
+        bool recursive = false;                              // 该目录本身是模式：其下全部包含
+    };
+    std::vector<Node> nodes{1};
+    std::set<std::string> patterns;
+
+public:
+    Cone() = default;
+    explicit Cone(const std::set<std::string>& dirs);
+
+    // 规范化目录模式：去掉 "./" 前缀与末尾的 '/'；空串、绝对路径与 ".." 无效
+    [[nodiscard]] static std::optional<std::string> normalize(std::string_view dir);
+
+    void add(std::string_view dir); // dir 须已规范化
+    [[nodiscard]] bool enabled() const { return !patterns.empty(); }
+    [[nodiscard]] bool contains(std::string_view path) const { return outside_prefix(path) == 0; }
+    // path 在范围之外时，返回整个位于范围之外的最上层目录前缀的长度（含末尾 '/'），否则为 0
+    [[nodiscard]] size_t outside_prefix(std::string_view path) const;
+    [[nodiscard]] const std::set<std::string>& dirs() const { return patterns; }
+};
+
+// Sparse index: one commit's mapping with every directory wholly outside the cone collapsed into
+// a single "<dir>/" entry naming a tree file. A tree file is the serialized map of that directory's
+// entries, named by its SHA-1, so a new commit splices its bytes back in without decoding them and
+// the index grows with the checked-out part of the tree only.
+struct Index {
+    std::string commit;                         // 快照对应的提交
+    std::set<std::string> patterns;             // 建立快照时的稀疏模式
+    std::map<std::string, std::string> entries; // 路径 -> blob ID；折叠的目录 "<dir>/" -> 树 ID
+    std::map<std::string, size_t> sizes;        // 折叠的目录 -> 其中的条目数
+
+    // 由完整映射建立，树文件写入 treeDir（已存在的不再写）
+    [[nodiscard]] static Index build(std::string commit,
+                                     const Cone& cone,
+                                     const std::map<std::string, std::string>& mapping,
+                                     const std::filesystem::path& treeDir);
+
+    // path 所在的折叠目录（"<dir>/"），不在任何折叠目录中时为空
+    [[nodiscard]] std::optional<std::string> collapsed(std::string_view path) const;
+    [[nodiscard]] std::optional<std::string> find(std::string_view path, const std::filesystem::path& treeDir) const;
+    void expand(const std::string& dir, const std::filesystem::path& treeDir); // 把折叠目录换回其中的条目
+    // 写出与 ser::serialize(完整映射) 字节相同的内容：折叠目录按序原样拷贝树文件
+    void write_mapping(std::ostream& out, const std::filesystem::path& treeDir) const;
+};
+
+void serialize(const Index& obj, std::ostream& out);
+void deserialize(Index& obj, std::istream& in);
+
+} // namespace sparse
+
+#endif // SPARSE_H
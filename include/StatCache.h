@@ -0,0 +1,46 @@
+#ifndef STAT_CACHE_H
+#define STAT_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <string>
+
+// Stat cache for tracked files: each path's size and mtime when its content was last hashed,
+// with that hash. A file whose size and mtime still match is not read again, so checking an
+// unchanged tree for modifications costs one stat per tracked file instead of hashing every byte.
+// Files modified within a second of being hashed are not cached: a second write in the same
+// clock tick could leave size and mtime unchanged.
+namespace worktree {
+
+struct Stat {
+    std::int64_t size = 0;
+    std::int64_t mtime = 0; // file_time_type 的计数
+    std::string blob;       // 此时内容的 blob ID
+};
+
+void serialize(const Stat& obj, std::ostream& out);
+void deserialize(Stat& obj, std::istream& in);
+
+class StatCache {
+private:
+    std::filesystem::path file;
+    std::map<std::string, Stat> entries;
+    std::set<std::string> seen; // 本次查询过的路径，save 时只保留这些
+    bool dirty = false;
+
+public:
+    explicit StatCache(std::filesystem::path cacheFile);
+
+    // path 当前内容的 blob ID，不存在（或不是普通文件）时为 nullopt
+    [[nodiscard]] std::optional<std::string> blob_id(const std::string& path);
+    void save(); // 丢弃本次未查询的路径；有变化时才写回
+};
+
+} // namespace worktree
+
+#endif // STAT_CACHE_H
@@ -0,0 +1,46 @@
+#ifndef UNTRACKED_H
+#define UNTRACKED_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Untracked cache: for each working-tree directory, its mtime plus the files and subdirectories it
+// held when last read. A directory whose mtime still matches is not read again, so a scan of an
+// unchanged tree costs one stat per directory instead of a readdir of every directory.
+// Only names are cached, not whether they are tracked: callers filter against the index on every
+// scan, so staging or unstaging a file never leaves the cache stale.
+namespace untracked {
+
+struct Dir {
+    std::int64_t mtime = 0;         // 目录的修改时间（file_time_type 的计数）
+    std::vector<std::string> files; // 目录下的文件名
+    std::vector<std::string> dirs;  // 目录下的子目录名
+};
+
+void serialize(const Dir& obj, std::ostream& out);
+void deserialize(Dir& obj, std::istream& in);
+
+class Cache {
+private:
+    std::filesystem::path file;
+    std::map<std::string, Dir> entries; // 相对路径（根目录为 ""）-> 缓存的目录内容
+    bool dirty = false;
+
+public:
+    explicit Cache(std::filesystem::path cacheFile);
+
+    // 递归访问工作区中的每个文件（相对路径，'/' 分隔），跳过 .gitlite 以及 skipDir 返回 true 的目录
+    void scan(const std::function<bool(const std::string& dir)>& skipDir,
+              const std::function<void(const std::string& path)>& visit);
+    void save(); // 有变化时才写回
+};
+
+} // namespace untracked
+
+#endif // UNTRACKED_H
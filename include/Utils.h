@@ -29,21 +29,46 @@ public:
     SHA();
     std::string sha(std::string message);
 };
+// Incremental SHA-1 for data that is produced or consumed as a stream.
+class Context {
+private:
+    uint32_t H[5];
+    uint64_t length = 0;
+    uint8_t block[64];
+    size_t used = 0;
+    void transform(const uint8_t* chunk);
+
+public:
+    Context();
+    void update(std::string_view data);
+    std::string digest();
+};
+
 extern SHA sha;
 std::string sha1(std::string message);
 std::string sha1(std::string_view s1, std::string_view s2);
 std::string sha1(std::string_view s1, std::string_view s2, std::string_view s3, std::string_view s4);
 } // namespace SHA1
 
+// Small LZ77-style block compressor (no external dependencies).
+namespace LZ {
+std::string compress(std::string_view src);
+std::string decompress(std::string_view src, size_t rawSize);
+} // namespace LZ
+
 class Utils {
 public:
     static const int UID_LENGTH = 40;
+    // 40 位小写十六进制：来自外部（bundle、命令行）的 ID 在用作对象路径之前必须通过
+    static bool isObjectId(std::string_view id);
 
     // File operations
     static bool restrictedDelete(const std::filesystem::path& target);
     static void readContentsAsString(std::string& content, const std::filesystem::path& filepath);
     static void writeContents(const std::string& content, const std::filesystem::path& filePath);
     static void writeContents_safe(const std::string& content, const std::filesystem::path& filePath);
+    // 只读文件的廉价副本：先试硬链接，再试 reflink（FICLONE），都不支持时才复制内容；目标已存在时不做任何事
+    static void linkOrCopy(const std::filesystem::path& from, const std::filesystem::path& to);
 
     // Message and error reporting
     static void message(const std::string& msg);
@@ -1,7 +1,14 @@
 #include "GitEngine.h"
+#include "GitliteException.h"
 #include "Utils.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
 #include <filesystem>
 #include <iostream>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -27,21 +34,105 @@ inline void checkArgsNum(const vector<string>& args, int n) {
     }
 }
 
-int main(int argc, char* argv[]) {
-    vector<string> args;
-    for (int i = 1; i < argc; ++i) {
-        args.emplace_back(argv[i]);
+// 日期：Unix 秒数，或本地时间 YYYY-MM-DD[ HH:MM[:SS]]
+inline std::optional<std::chrono::system_clock::time_point> parseDate(const string& text) {
+    if (!text.empty() && std::ranges::all_of(text, [](unsigned char c) { return std::isdigit(c); })) {
+        return std::chrono::system_clock::from_time_t(static_cast<time_t>(std::stoll(text)));
     }
+    std::tm tm{};
+    char sep = ' ';
+    int n = std::sscanf(text.c_str(),
+                        "%d-%d-%d%c%d:%d:%d",
+                        &tm.tm_year,
+                        &tm.tm_mon,
+                        &tm.tm_mday,
+                        &sep,
+                        &tm.tm_hour,
+                        &tm.tm_min,
+                        &tm.tm_sec);
+    if (n != 3 && n != 6 && n != 7) {
+        return std::nullopt;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    time_t t = std::mktime(&tm);
+    if (t == -1) {
+        return std::nullopt;
+    }
+    return std::chrono::system_clock::from_time_t(t);
+}
 
-    checkNoArgs(args);
+// log [--oneline | --format=<fmt>] [-n N] [--since=<date>] [--until=<date>] [<rev> | A..B]
+// global-log 接受除修订范围以外的全部选项
+inline LogOptions parseLogOptions(const vector<string>& args, bool allowRange) {
+    LogOptions options;
+    auto date = [](const string& text) {
+        auto tp = parseDate(text);
+        if (!tp) {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+        return *tp;
+    };
+    for (size_t i = 1; i < args.size(); ++i) {
+        const auto& a = args[i];
+        if (a == "--oneline") {
+            options.oneline = true;
+        } else if (a.starts_with("--format=")) {
+            options.format = a.substr(9);
+        } else if ((a == "-n" && i + 1 < args.size()) || a.starts_with("--max-count=")) {
+            const string count = a == "-n" ? args[++i] : a.substr(12);
+            if (count.empty() || !std::ranges::all_of(count, [](unsigned char c) { return std::isdigit(c); })) {
+                Utils::exitWithMessage("Incorrect operands.");
+            }
+            options.limit = std::stoull(count);
+        } else if (a.starts_with("--since=")) {
+            options.since = date(a.substr(8));
+        } else if (a.starts_with("--until=")) {
+            options.until = date(a.substr(8));
+        } else if (allowRange && !a.starts_with("-") && !options.range) {
+            options.range = a;
+        } else {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+    }
+    return options;
+}
+
+inline int dispatch(const vector<string>& args) {
     GitEngine bloop;
-    string firstArg = args[0];
+    const string& firstArg = args[0];
 
     if (firstArg == "init") {
         checkArgsNum(args, 1);
         bloop.init();
-    } /*
-    else if (firstArg == "add-remote") {
+    } else if (firstArg == "clone") {
+        // clone [--depth N] [--filter=blob:none] [--shared] <source .gitlite> <directory>
+        int depth = 0;
+        bool blobless = false;
+        bool shared = false;
+        vector<string> rest;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (args[i] == "--depth" && i + 1 < args.size()) {
+                try {
+                    depth = std::stoi(args[++i]);
+                } catch (const std::exception&) {
+                    depth = 0;
+                }
+                if (depth <= 0) {
+                    Utils::exitWithMessage("Incorrect operands.");
+                }
+            } else if (args[i] == "--filter=blob:none") {
+                blobless = true;
+            } else if (args[i] == "--shared") {
+                shared = true;
+            } else {
+                rest.push_back(args[i]);
+            }
+        }
+        checkArgsNum(rest, 2);
+        bloop.clone(rest[0], rest[1], depth, blobless, shared);
+    } else if (firstArg == "add-remote") {
         checkCWD();
         checkArgsNum(args, 3);
         bloop.addRemote(args[1], args[2]);
@@ -49,9 +140,7 @@ int main(int argc, char* argv[]) {
         checkCWD();
         checkArgsNum(args, 2);
         bloop.rmRemote(args[1]);
-
-    }  */
-    else if (firstArg == "add") {
+    } else if (firstArg == "add") {
         checkCWD();
         checkArgsNum(args, 2);
         bloop.add(args[1]);
@@ -68,20 +157,34 @@ int main(int argc, char* argv[]) {
         bloop.rm(args[1]);
     } else if (firstArg == "log") {
         checkCWD();
-        checkArgsNum(args, 1);
-        bloop.log();
+        bloop.log(parseLogOptions(args, true));
     } else if (firstArg == "global-log") {
         checkCWD();
-        checkArgsNum(args, 1);
-        bloop.globalLog();
+        bloop.globalLog(parseLogOptions(args, false));
     } else if (firstArg == "find") {
         checkCWD();
-        checkArgsNum(args, 2);
-        bloop.find(args[1]);
+        // find <message> / find --grep <pattern>
+        if (args.size() == 3 && args[1] == "--grep") {
+            bloop.findGrep(args[2]);
+        } else {
+            checkArgsNum(args, 2);
+            bloop.find(args[1]);
+        }
     } else if (firstArg == "status") {
         checkCWD();
         checkArgsNum(args, 1);
         bloop.status();
+    } else if (firstArg == "diff") {
+        checkCWD();
+        // diff / diff --cached / diff <commit> <commit>
+        bool cached = args.size() == 2 && args[1] == "--cached";
+        vector<string> revs(args.begin() + (cached ? 2 : 1), args.end());
+        // 选项不能当作提交：diff --cached <c1> 之类的组合一律拒绝
+        bool option = std::ranges::any_of(revs, [](const string& rev) { return rev.starts_with("--"); });
+        if ((!revs.empty() && revs.size() != 2) || option) {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+        bloop.diff(revs, cached);
     } else if (firstArg == "checkout") {
         checkCWD();
         if (args.size() == 2) {
@@ -115,7 +218,7 @@ int main(int argc, char* argv[]) {
         checkCWD();
         checkArgsNum(args, 2);
         bloop.merge(args[1]);
-    } /*else if (firstArg == "push") {
+    } else if (firstArg == "push") {
         checkCWD();
         checkArgsNum(args, 3);
         bloop.push(args[1], args[2]);
@@ -127,11 +230,92 @@ int main(int argc, char* argv[]) {
         checkCWD();
         checkArgsNum(args, 3);
         bloop.pull(args[1], args[2]);
-    } */
-    else {
+    } else if (firstArg == "bundle") {
+        checkCWD();
+        // bundle create [--compress] <file> <branch> [^<base>] / bundle unbundle <file>
+        if (args.size() >= 2 && args[1] == "create") {
+            vector<string> rest(args.begin() + 2, args.end());
+            bool compress = !rest.empty() && rest[0] == "--compress";
+            if (compress) {
+                rest.erase(rest.begin());
+            }
+            if (rest.size() == 2) {
+                bloop.bundleCreate(rest[0], rest[1], std::nullopt, compress);
+            } else if (rest.size() == 3 && rest[2].starts_with('^')) {
+                bloop.bundleCreate(rest[0], rest[1], rest[2].substr(1), compress);
+            } else {
+                Utils::exitWithMessage("Incorrect operands.");
+            }
+        } else if (args.size() == 3 && args[1] == "unbundle") {
+            bloop.unbundle(args[2]);
+        } else {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+    } else if (firstArg == "gc") {
+        checkCWD();
+        // gc [--prune=now | --prune=<date>]，默认保留两周内写入的不可达对象
+        auto expire = std::chrono::system_clock::now() - std::chrono::weeks(2);
+        if (args.size() == 2 && args[1] == "--prune=now") {
+            expire = std::chrono::system_clock::now();
+        } else if (args.size() == 2 && args[1].starts_with("--prune=")) {
+            auto tp = parseDate(args[1].substr(8));
+            if (!tp) {
+                Utils::exitWithMessage("Incorrect operands.");
+            }
+            expire = *tp;
+        } else {
+            checkArgsNum(args, 1);
+        }
+        bloop.gc(expire);
+    } else if (firstArg == "fsck") {
+        checkCWD();
+        // fsck [--quick]
+        if (args.size() == 2 && args[1] == "--quick") {
+            bloop.fsck(true);
+        } else {
+            checkArgsNum(args, 1);
+            bloop.fsck(false);
+        }
+    } else if (firstArg == "bitmap") {
+        checkCWD();
+        checkArgsNum(args, 1);
+        bloop.bitmap();
+    } else if (firstArg == "pack-refs") {
+        checkCWD();
+        checkArgsNum(args, 1);
+        bloop.packRefs();
+    } else if (firstArg == "sparse-checkout") {
+        checkCWD();
+        // sparse-checkout set <dir>... / sparse-checkout list / sparse-checkout disable
+        if (args.size() >= 3 && args[1] == "set") {
+            bloop.sparseSet({args.begin() + 2, args.end()});
+        } else if (args.size() == 2 && args[1] == "list") {
+            bloop.sparseList();
+        } else if (args.size() == 2 && args[1] == "disable") {
+            bloop.sparseDisable();
+        } else {
+            Utils::exitWithMessage("Incorrect operands.");
+        }
+    } else {
         std::cout << "No command with that name exists." << std::endl;
         return 0;
     }
 
     return 0;
 }
+
+int main(int argc, char* argv[]) {
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        args.emplace_back(argv[i]);
+    }
+
+    checkNoArgs(args);
+    // 锁冲突、并发更新等需要回滚的错误以异常抛出：栈上的事务在此之前已析构并丢弃临时文件
+    try {
+        return dispatch(args);
+    } catch (const GitliteException& e) {
+        Utils::message(e.what());
+    }
+    return 0;
+}
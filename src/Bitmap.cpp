@@ -0,0 +1,181 @@
+#include "Bitmap.h"
+#include "Utils.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace bitmap {
+
+namespace {
+
+// 标记字：bit 0 为连续段的值，bit 1-32 为连续干净字的个数，bit 33-63 为其后字面字的个数
+constexpr uint64_t MAX_RUN = (uint64_t{1} << 32) - 1;
+constexpr uint64_t MAX_LITERALS = (uint64_t{1} << 31) - 1;
+constexpr uint64_t ALL = ~uint64_t{0};
+
+void put_word(std::string& out, uint64_t w) {
+    char buf[sizeof(w)];
+    std::memcpy(buf, &w, sizeof(w));
+    out.append(buf, sizeof(w));
+}
+
+uint64_t get_word(std::string_view data, size_t index) {
+    uint64_t w;
+    std::memcpy(&w, data.data() + index * sizeof(w), sizeof(w));
+    return w;
+}
+
+} // namespace
+
+void Bitmap::set(size_t pos) {
+    size_t w = pos / 64;
+    if (w >= words.size()) {
+        words.resize(w + 1, 0);
+    }
+    words[w] |= uint64_t{1} << (pos % 64);
+}
+
+bool Bitmap::test(size_t pos) const {
+    size_t w = pos / 64;
+    return w < words.size() && (words[w] >> (pos % 64) & 1) != 0;
+}
+
+Bitmap& Bitmap::operator|=(const Bitmap& other) {
+    if (other.words.size() > words.size()) {
+        words.resize(other.words.size(), 0);
+    }
+    for (size_t i = 0; i < other.words.size(); ++i) {
+        words[i] |= other.words[i];
+    }
+    return *this;
+}
+
+Bitmap& Bitmap::and_not(const Bitmap& other) {
+    size_t n = std::min(words.size(), other.words.size());
+    for (size_t i = 0; i < n; ++i) {
+        words[i] &= ~other.words[i];
+    }
+    return *this;
+}
+
+size_t Bitmap::count() const {
+    size_t total = 0;
+    for (uint64_t w : words) {
+        total += static_cast<size_t>(std::popcount(w));
+    }
+    return total;
+}
+
+std::vector<size_t> Bitmap::positions() const {
+    std::vector<size_t> out;
+    for (size_t i = 0; i < words.size(); ++i) {
+        for (uint64_t w = words[i]; w != 0; w &= w - 1) {
+            out.push_back(i * 64 + static_cast<size_t>(std::countr_zero(w)));
+        }
+    }
+    return out;
+}
+
+std::string Bitmap::encode() const {
+    std::string out;
+    put_word(out, words.size());
+    size_t i = 0;
+    while (i < words.size()) {
+        uint64_t runBit = words[i] == ALL ? 1 : 0;
+        uint64_t run = 0;
+        while (i < words.size() && run < MAX_RUN && (words[i] == 0 || words[i] == ALL) &&
+               (words[i] == ALL) == (runBit == 1)) {
+            ++run;
+            ++i;
+        }
+        size_t start = i;
+        while (i < words.size() && i - start < MAX_LITERALS && words[i] != 0 && words[i] != ALL) {
+            ++i;
+        }
+        put_word(out, runBit | run << 1 | static_cast<uint64_t>(i - start) << 33);
+        for (size_t k = start; k < i; ++k) {
+            put_word(out, words[k]);
+        }
+    }
+    return out;
+}
+
+Bitmap Bitmap::decode(std::string_view data) {
+    if (data.size() % sizeof(uint64_t) != 0 || data.empty()) {
+        throw std::invalid_argument("corrupt bitmap");
+    }
+    size_t n = data.size() / sizeof(uint64_t);
+    uint64_t total = get_word(data, 0);
+    // 总长度来自文件，不能直接 reserve；逐段检查不越过 total 即可
+    Bitmap bm;
+    size_t i = 1;
+    while (i < n) {
+        uint64_t marker = get_word(data, i++);
+        uint64_t run = marker >> 1 & MAX_RUN;
+        uint64_t literals = marker >> 33;
+        if (run > total - bm.words.size() || literals > n - i || literals > total - bm.words.size() - run) {
+            throw std::invalid_argument("corrupt bitmap");
+        }
+        bm.words.insert(bm.words.end(), run, (marker & 1) != 0 ? ALL : 0);
+        for (uint64_t k = 0; k < literals; ++k) {
+            bm.words.push_back(get_word(data, i++));
+        }
+    }
+    if (bm.words.size() != total) {
+        throw std::invalid_argument("corrupt bitmap");
+    }
+    return bm;
+}
+
+ObjectTable::ObjectTable(const fs::path& gitDir) : file(gitDir / "bitmaps" / "OBJECTS") {
+    if (!fs::exists(file)) {
+        return;
+    }
+    std::string raw;
+    Utils::readContentsAsString(raw, file);
+    constexpr size_t len = Utils::UID_LENGTH;
+    ids.reserve(raw.size() / len);
+    for (size_t i = 0; i + len <= raw.size(); i += len) {
+        index.emplace(raw.substr(i, len), ids.size());
+        ids.emplace_back(raw, i, len);
+    }
+    saved = ids.size();
+}
+
+std::optional<size_t> ObjectTable::find(const std::string& id) const {
+    auto it = index.find(id);
+    if (it == index.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+size_t ObjectTable::assign(const std::string& id) {
+    auto [it, inserted] = index.try_emplace(id, ids.size());
+    if (inserted) {
+        ids.push_back(id);
+    }
+    return it->second;
+}
+
+void ObjectTable::save() {
+    if (saved == ids.size()) {
+        return;
+    }
+    fs::create_directories(file.parent_path());
+    std::ofstream out(file, std::ios::binary | std::ios::app);
+    for (size_t i = saved; i < ids.size(); ++i) {
+        out.write(ids[i].data(), static_cast<std::streamsize>(ids[i].size()));
+    }
+    out.flush();
+    if (!out) {
+        throw std::invalid_argument("cannot write file");
+    }
+    saved = ids.size();
+}
+
+} // namespace bitmap
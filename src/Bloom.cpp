@@ -0,0 +1,126 @@
+#include "Bloom.h"
+#include "Durable.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <functional>
+
+namespace fs = std::filesystem;
+
+namespace bloom {
+
+namespace {
+
+constexpr uint64_t BITS_PER_ID = 10; // 配合 7 个哈希，满载时误判率约 1%
+constexpr int HASHES = 7;
+constexpr uint64_t MIN_CAPACITY = 1024;
+constexpr std::streamoff HEADER = 2 * sizeof(uint64_t);
+
+size_t bit_bytes(uint64_t capacity) {
+    return static_cast<size_t>((capacity * BITS_PER_ID + 63) / 64 * 8);
+}
+
+uint64_t parse_hex(std::string_view digits, uint64_t fallback) {
+    uint64_t value = 0;
+    auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value, 16);
+    return ec == std::errc() && ptr == digits.data() + digits.size() ? value : fallback;
+}
+
+} // namespace
+
+template <typename F>
+void Filter::positions(std::string_view id, F&& f) const {
+    // 双重哈希：ID 的前后两段十六进制各作一个 64 位哈希
+    uint64_t fallback = std::hash<std::string_view>{}(id);
+    uint64_t h1 = id.size() >= 32 ? parse_hex(id.substr(0, 16), fallback) : fallback;
+    uint64_t h2 = id.size() >= 32 ? parse_hex(id.substr(16, 16), fallback >> 7) : fallback >> 7;
+    h2 |= 1;
+    const uint64_t m = bits.size() * 8;
+    for (int i = 0; i < HASHES; ++i) {
+        f(static_cast<size_t>((h1 + static_cast<uint64_t>(i) * h2) % m));
+    }
+}
+
+Filter::Filter(fs::path filterFile) : file(std::move(filterFile)) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        return;
+    }
+    in.read(reinterpret_cast<char*>(&capacity), sizeof(capacity));
+    in.read(reinterpret_cast<char*>(&added), sizeof(added));
+    if (!in || capacity == 0 || capacity > (uint64_t{1} << 40)) {
+        return;
+    }
+    bits.resize(bit_bytes(capacity));
+    in.read(reinterpret_cast<char*>(bits.data()), static_cast<std::streamsize>(bits.size()));
+    // 长度不符（写到一半或已损坏）时整个不用
+    if (static_cast<size_t>(in.gcount()) != bits.size() || in.peek() != std::ifstream::traits_type::eof()) {
+        bits.clear();
+    }
+}
+
+void Filter::create(const fs::path& filterFile, const std::vector<std::string>& ids) {
+    Filter filter;
+    filter.capacity = std::max<uint64_t>(MIN_CAPACITY, 2 * ids.size());
+    filter.added = ids.size();
+    filter.bits.resize(bit_bytes(filter.capacity));
+    for (const auto& id : ids) {
+        filter.positions(id, [&](size_t pos) { filter.bits[pos / 8] |= static_cast<uint8_t>(1U << (pos % 8)); });
+    }
+    // 不经过事务：重建可能发生在事务中途，之后的读取需要立即看到新文件
+    auto tmp = durable::temp_path(filterFile);
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&filter.capacity), sizeof(filter.capacity));
+        out.write(reinterpret_cast<const char*>(&filter.added), sizeof(filter.added));
+        out.write(reinterpret_cast<const char*>(filter.bits.data()), static_cast<std::streamsize>(filter.bits.size()));
+    }
+    fs::rename(tmp, filterFile);
+}
+
+bool Filter::may_contain(std::string_view id) const {
+    if (!enabled()) {
+        return true;
+    }
+    bool all = true;
+    positions(id, [&](size_t pos) { all = all && (bits[pos / 8] >> (pos % 8) & 1U) != 0; });
+    return all;
+}
+
+void Filter::add(const std::vector<std::string>& ids) {
+    if (!enabled()) {
+        return;
+    }
+    std::fstream io(file, std::ios::in | std::ios::out | std::ios::binary);
+    if (!io.is_open()) {
+        bits.clear();
+        return;
+    }
+    // 逐字节读出、置位、写回：其他进程同时置的位最多丢失一个字节，只会造成多余的写入
+    uint64_t fresh = 0;
+    for (const auto& id : ids) {
+        bool changed = false;
+        positions(id, [&](size_t pos) {
+            auto mask = static_cast<uint8_t>(1U << (pos % 8));
+            if ((bits[pos / 8] & mask) != 0) {
+                return;
+            }
+            const std::streamoff offset = HEADER + static_cast<std::streamoff>(pos / 8);
+            uint8_t byte = 0;
+            io.seekg(offset);
+            io.read(reinterpret_cast<char*>(&byte), 1);
+            bits[pos / 8] |= static_cast<uint8_t>(byte | mask);
+            io.seekp(offset);
+            io.write(reinterpret_cast<const char*>(&bits[pos / 8]), 1);
+            changed = true;
+        });
+        fresh += changed ? 1 : 0;
+    }
+    if (fresh > 0) {
+        added += fresh;
+        io.seekp(sizeof(capacity));
+        io.write(reinterpret_cast<const char*>(&added), sizeof(added));
+    }
+}
+
+} // namespace bloom
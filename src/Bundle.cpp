@@ -0,0 +1,153 @@
+#include "Bundle.h"
+#include "GitliteException.h"
+#include "Serialization.hpp"
+#include <limits>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace bundle {
+
+namespace {
+constexpr std::string_view MAGIC = "# gitlite bundle v1\n";
+constexpr size_t IO_BUFFER = size_t{1} << 20;
+constexpr uint8_t METHOD_RAW = 0;
+constexpr uint8_t METHOD_LZ = 1;
+} // namespace
+
+void Writer::put(std::string_view bytes) {
+    ctx.update(bytes);
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+Writer::Writer(const fs::path& target, const Header& header) : compressed(header.compressed), buffer(IO_BUFFER) {
+    file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.open(target, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::invalid_argument("cannot create file");
+    }
+    put(MAGIC);
+    put(ser::serialize(header.branch));
+    put(ser::serialize(header.tip));
+    put(ser::serialize(header.prerequisites));
+    put(ser::serialize(static_cast<uint8_t>(header.compressed)));
+}
+
+void Writer::add(ObjectKind kind, std::string_view id, std::string_view content) {
+    uint8_t method = METHOD_RAW;
+    std::string packed;
+    if (compressed) {
+        packed = LZ::compress(content);
+        // 压缩不划算时保留原文
+        if (packed.size() < content.size()) {
+            method = METHOD_LZ;
+        }
+    }
+    put(ser::serialize(static_cast<uint8_t>(kind)));
+    put(ser::serialize(id));
+    put(ser::serialize(method));
+    put(ser::serialize(static_cast<uint64_t>(content.size())));
+    put(ser::serialize(method == METHOD_LZ ? std::string_view(packed) : content));
+}
+
+void Writer::finish() {
+    put(ser::serialize(static_cast<uint8_t>(ObjectKind::End)));
+    auto checksum = ctx.digest();
+    file.write(checksum.data(), static_cast<std::streamsize>(checksum.size()));
+    file.flush();
+    if (!file) {
+        throw std::invalid_argument("cannot write file");
+    }
+}
+
+void Reader::get(char* dst, size_t n) {
+    file.read(dst, static_cast<std::streamsize>(n));
+    if (static_cast<size_t>(file.gcount()) != n) {
+        throw GitliteException("Bundle is corrupt.");
+    }
+    remaining -= static_cast<std::streamoff>(n);
+    ctx.update(std::string_view(dst, n));
+}
+
+size_t Reader::get_size() {
+    size_t len;
+    get(reinterpret_cast<char*>(&len), sizeof(len));
+    return len;
+}
+
+std::string Reader::get_string() {
+    size_t len = get_size();
+    // 长度字段损坏时不要盲目分配
+    if (len > static_cast<size_t>(std::numeric_limits<std::streamsize>::max()) ||
+        static_cast<std::streamoff>(len) > remaining) {
+        throw GitliteException("Bundle is corrupt.");
+    }
+    std::string s(len, '\0');
+    get(s.data(), len);
+    return s;
+}
+
+Reader::Reader(const fs::path& source) : buffer(IO_BUFFER) {
+    file.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    file.open(source, std::ios::binary);
+    if (!file.is_open()) {
+        throw GitliteException("Bundle file does not exist.");
+    }
+    remaining = static_cast<std::streamoff>(fs::file_size(source));
+    std::string magic(MAGIC.size(), '\0');
+    file.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+    if (file.gcount() != static_cast<std::streamsize>(MAGIC.size()) || magic != MAGIC) {
+        throw GitliteException("Not a gitlite bundle.");
+    }
+    remaining -= static_cast<std::streamoff>(MAGIC.size());
+    ctx.update(magic);
+    head.branch = get_string();
+    head.tip = get_string();
+    size_t count = get_size();
+    for (size_t i = 0; i < count; ++i) {
+        head.prerequisites.push_back(get_string());
+    }
+    uint8_t flags;
+    get(reinterpret_cast<char*>(&flags), sizeof(flags));
+    head.compressed = flags != 0;
+}
+
+bool Reader::next(ObjectKind& kind, std::string& id, std::string& content) {
+    uint8_t k;
+    get(reinterpret_cast<char*>(&k), sizeof(k));
+    kind = static_cast<ObjectKind>(k);
+    if (kind == ObjectKind::End) {
+        return false;
+    }
+    if (kind != ObjectKind::Blob && kind != ObjectKind::Commit) {
+        throw GitliteException("Bundle is corrupt.");
+    }
+    id = get_string();
+    uint8_t method;
+    get(reinterpret_cast<char*>(&method), sizeof(method));
+    uint64_t rawSize;
+    get(reinterpret_cast<char*>(&rawSize), sizeof(rawSize));
+    content = get_string();
+    if (method == METHOD_LZ) {
+        // 每个字节最多展开为约 255 字节，超出即说明大小字段损坏
+        if (rawSize / 256 > content.size()) {
+            throw GitliteException("Bundle is corrupt.");
+        }
+        try {
+            content = LZ::decompress(content, rawSize);
+        } catch (const std::invalid_argument&) {
+            throw GitliteException("Bundle is corrupt.");
+        }
+    } else if (method != METHOD_RAW || content.size() != rawSize) {
+        throw GitliteException("Bundle is corrupt.");
+    }
+    return true;
+}
+
+bool Reader::verify() {
+    std::string expected(40, '\0');
+    file.read(expected.data(), static_cast<std::streamsize>(expected.size()));
+    return file.gcount() == 40 && expected == ctx.digest();
+}
+
+} // namespace bundle
@@ -0,0 +1,105 @@
+#include "CommitScanner.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace scan {
+
+namespace {
+// 每个线程每批处理的提交数：足够摊薄线程启动开销，又让内存占用有界
+constexpr size_t BATCH_PER_JOB = 256;
+} // namespace
+
+unsigned default_jobs() {
+    if (const char* env = std::getenv("GITLITE_JOBS")) {
+        try {
+            int n = std::stoi(env);
+            if (n > 0) {
+                return static_cast<unsigned>(n);
+            }
+        } catch (const std::exception&) {
+        }
+    }
+    return std::max(1U, std::thread::hardware_concurrency());
+}
+
+void parallel_for(size_t count, unsigned jobs, const std::function<void(size_t, unsigned)>& body) {
+    if (jobs <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            body(i, 0);
+        }
+        return;
+    }
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex errorLock;
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(jobs);
+        for (unsigned t = 0; t < jobs; ++t) {
+            workers.emplace_back([&, t] {
+                try {
+                    for (size_t i = next++; i < count; i = next++) {
+                        body(i, t);
+                    }
+                } catch (...) {
+                    std::scoped_lock lock(errorLock);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    next = count;
+                }
+            });
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void for_each_commit(const std::vector<std::filesystem::path>& files,
+                     unsigned jobs,
+                     const renderer& render,
+                     const emitter& emit,
+                     Decode decode) {
+    auto load = [decode](Commit& comm, const std::filesystem::path& file) {
+        if (decode == Decode::Header) {
+            deserialize_header_from_file(comm, file);
+        } else {
+            ser::deserialize_from_file(comm, file);
+        }
+    };
+    Commit comm;
+    if (jobs <= 1 || files.size() <= BATCH_PER_JOB) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            load(comm, files[i]);
+            auto text = render(comm);
+            if (!emit(i, text)) {
+                return;
+            }
+        }
+        return;
+    }
+
+    const size_t batch = BATCH_PER_JOB * jobs;
+    std::vector<std::string> out;
+    for (size_t begin = 0; begin < files.size(); begin += batch) {
+        const size_t end = std::min(files.size(), begin + batch);
+        out.assign(end - begin, {});
+        std::vector<Commit> local(jobs);
+        parallel_for(end - begin, jobs, [&](size_t i, unsigned worker) {
+            load(local[worker], files[begin + i]);
+            out[i] = render(local[worker]);
+        });
+        for (size_t i = begin; i < end; ++i) {
+            if (!emit(i, out[i - begin])) {
+                return;
+            }
+        }
+    }
+}
+
+} // namespace scan
@@ -0,0 +1,377 @@
+#include "Diff.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <unordered_map>
+
+namespace diff {
+
+namespace {
+
+// 一次比较的状态：两侧都已映射为整数行号，changed 标记不在公共子序列中的行
+class Myers {
+private:
+    const std::vector<uint32_t>& A;
+    const std::vector<uint32_t>& B;
+    std::vector<bool>& changedA;
+    std::vector<bool>& changedB;
+    std::vector<ptrdiff_t> vf;
+    std::vector<ptrdiff_t> vb;
+
+    struct Snake {
+        ptrdiff_t x1, y1, x2, y2;
+    };
+
+    // 在 A[aLo, aHi) 与 B[bLo, bHi) 之间找到中间蛇（middle snake），坐标相对 aLo/bLo
+    Snake middle_snake(ptrdiff_t aLo, ptrdiff_t aHi, ptrdiff_t bLo, ptrdiff_t bHi) {
+        const ptrdiff_t N = aHi - aLo;
+        const ptrdiff_t M = bHi - bLo;
+        const ptrdiff_t delta = N - M;
+        const bool odd = (delta & 1) != 0;
+        const ptrdiff_t maxD = (N + M + 1) / 2;
+        // 编辑距离超过 max(256, sqrt(N + M)) 时退化为近似解，避免最坏 O(NM)
+        const auto costLimit = std::max<ptrdiff_t>(256, static_cast<ptrdiff_t>(std::sqrt(double(N + M))));
+
+        const ptrdiff_t limitD = std::min(maxD, costLimit);
+        const ptrdiff_t fOff = limitD + 1;
+        const ptrdiff_t bOff = limitD + 1 - delta;
+        vf.assign(2 * limitD + 3, 0);
+        vb.assign(2 * limitD + 3, 0);
+        auto F = [&](ptrdiff_t k) -> ptrdiff_t& { return vf[k + fOff]; };
+        auto R = [&](ptrdiff_t k) -> ptrdiff_t& { return vb[k + bOff]; };
+        F(1) = 0;
+        R(delta - 1) = N;
+
+        for (ptrdiff_t d = 0; d <= maxD; ++d) {
+            for (ptrdiff_t k = -d; k <= d; k += 2) {
+                ptrdiff_t x = (k == -d || (k != d && F(k - 1) < F(k + 1))) ? F(k + 1) : F(k - 1) + 1;
+                ptrdiff_t y = x - k;
+                const ptrdiff_t sx = x;
+                const ptrdiff_t sy = y;
+                while (x < N && y < M && A[aLo + x] == B[bLo + y]) {
+                    ++x;
+                    ++y;
+                }
+                F(k) = x;
+                if (odd && k >= delta - (d - 1) && k <= delta + (d - 1) && R(k) <= x) {
+                    return {sx, sy, x, y};
+                }
+            }
+            for (ptrdiff_t k = delta - d; k <= delta + d; k += 2) {
+                ptrdiff_t x = (k == delta + d || (k != delta - d && R(k - 1) < R(k + 1))) ? R(k - 1) : R(k + 1) - 1;
+                ptrdiff_t y = x - k;
+                const ptrdiff_t ex = x;
+                const ptrdiff_t ey = y;
+                while (x > 0 && y > 0 && A[aLo + x - 1] == B[bLo + y - 1]) {
+                    --x;
+                    --y;
+                }
+                R(k) = x;
+                if (!odd && k >= -d && k <= d && x <= F(k)) {
+                    return {x, y, ex, ey};
+                }
+            }
+            if (d >= costLimit) {
+                // 取正向走得最远的有效位置作为分割点
+                ptrdiff_t bestX = -1;
+                ptrdiff_t bestY = -1;
+                for (ptrdiff_t k = -d; k <= d; k += 2) {
+                    ptrdiff_t x = F(k);
+                    ptrdiff_t y = x - k;
+                    if (x <= N && y >= 0 && y <= M && x + y > bestX + bestY) {
+                        bestX = x;
+                        bestY = y;
+                    }
+                }
+                return {bestX, bestY, bestX, bestY};
+            }
+        }
+        return {N, M, N, M}; // 不可达
+    }
+
+public:
+    Myers(const std::vector<uint32_t>& a,
+          const std::vector<uint32_t>& b,
+          std::vector<bool>& changedA,
+          std::vector<bool>& changedB)
+        : A(a), B(b), changedA(changedA), changedB(changedB) {}
+
+    void compare(ptrdiff_t aLo, ptrdiff_t aHi, ptrdiff_t bLo, ptrdiff_t bHi) {
+        while (aLo < aHi && bLo < bHi && A[aLo] == B[bLo]) {
+            ++aLo;
+            ++bLo;
+        }
+        while (aLo < aHi && bLo < bHi && A[aHi - 1] == B[bHi - 1]) {
+            --aHi;
+            --bHi;
+        }
+        if (aLo == aHi) {
+            std::fill(changedB.begin() + bLo, changedB.begin() + bHi, true);
+            return;
+        }
+        if (bLo == bHi) {
+            std::fill(changedA.begin() + aLo, changedA.begin() + aHi, true);
+            return;
+        }
+        Snake s = middle_snake(aLo, aHi, bLo, bHi);
+        if (s.x1 < 0 || (s.x2 == 0 && s.y2 == 0) || (s.x1 == aHi - aLo && s.y1 == bHi - bLo)) {
+            // 无法再分割（只会在近似模式的退化情形出现）：整段视为替换
+            std::fill(changedA.begin() + aLo, changedA.begin() + aHi, true);
+            std::fill(changedB.begin() + bLo, changedB.begin() + bHi, true);
+            return;
+        }
+        compare(aLo, aLo + s.x1, bLo, bLo + s.y1);
+        compare(aLo + s.x2, aHi, bLo + s.y2, bHi);
+    }
+};
+
+void append_range(std::string& out, size_t pos, size_t len) {
+    // 统一格式：长度为 0 时起始行号指向前一行，长度为 1 时省略长度
+    if (len == 1) {
+        std::format_to(std::back_inserter(out), "{}", pos + 1);
+    } else {
+        std::format_to(std::back_inserter(out), "{},{}", len == 0 ? pos : pos + 1, len);
+    }
+}
+
+constexpr std::string_view CONFLICT_BEGIN = "<<<<<<< HEAD\n";
+constexpr std::string_view CONFLICT_SEP = "=======\n";
+constexpr std::string_view CONFLICT_END = ">>>>>>>\n";
+
+// 冲突标记必须独占一行
+void append_text(std::string& out, std::string_view text) {
+    out.append(text);
+    if (!text.empty() && text.back() != '\n') {
+        out.push_back('\n');
+    }
+}
+
+// lines[from, to) 在原文中是连续的，直接按字节区间取出
+std::string_view span(const std::vector<std::string_view>& lines, size_t from, size_t to) {
+    if (from == to) {
+        return {};
+    }
+    const char* begin = lines[from].data();
+    const char* end = lines[to - 1].data() + lines[to - 1].size();
+    return {begin, static_cast<size_t>(end - begin)};
+}
+
+void append_line(std::string& out, char mark, std::string_view line) {
+    out.push_back(mark);
+    out.append(line);
+    if (line.empty() || line.back() != '\n') {
+        out.append("\n\\ No newline at end of file\n");
+    }
+}
+
+} // namespace
+
+std::vector<std::string_view> split_lines(std::string_view text) {
+    std::vector<std::string_view> lines;
+    lines.reserve(static_cast<size_t>(std::count(text.begin(), text.end(), '\n')) + 1);
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        end = end == std::string_view::npos ? text.size() : end + 1;
+        lines.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    return lines;
+}
+
+std::vector<Chunk> diff_lines(const std::vector<std::string_view>& a, const std::vector<std::string_view>& b) {
+    // 行内容只哈希一次，之后全部比较都是整数比较
+    std::unordered_map<std::string_view, uint32_t> intern;
+    intern.reserve(a.size() + b.size());
+    auto encode = [&](const std::vector<std::string_view>& lines) {
+        std::vector<uint32_t> ids;
+        ids.reserve(lines.size());
+        for (auto line : lines) {
+            ids.push_back(intern.try_emplace(line, static_cast<uint32_t>(intern.size())).first->second);
+        }
+        return ids;
+    };
+    auto A = encode(a);
+    auto B = encode(b);
+
+    std::vector<bool> changedA(A.size());
+    std::vector<bool> changedB(B.size());
+    Myers(A, B, changedA, changedB)
+        .compare(0, static_cast<ptrdiff_t>(A.size()), 0, static_cast<ptrdiff_t>(B.size()));
+
+    std::vector<Chunk> chunks;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < A.size() || j < B.size()) {
+        if (i < A.size() && j < B.size() && !changedA[i] && !changedB[j]) {
+            ++i;
+            ++j;
+            continue;
+        }
+        Chunk c{i, 0, j, 0};
+        while (i < A.size() && changedA[i]) {
+            ++i;
+        }
+        while (j < B.size() && changedB[j]) {
+            ++j;
+        }
+        c.aLen = i - c.aPos;
+        c.bLen = j - c.bPos;
+        chunks.push_back(c);
+    }
+    return chunks;
+}
+
+bool is_binary(std::string_view text) {
+    return text.substr(0, 8000).find('\0') != std::string_view::npos;
+}
+
+void unified(std::string& out,
+             std::string_view aName,
+             std::string_view bName,
+             std::string_view a,
+             std::string_view b,
+             size_t context) {
+    if (is_binary(a) || is_binary(b)) {
+        std::format_to(std::back_inserter(out), "Binary files {} and {} differ\n", aName, bName);
+        return;
+    }
+    auto la = split_lines(a);
+    auto lb = split_lines(b);
+    auto chunks = diff_lines(la, lb);
+    if (chunks.empty()) {
+        return;
+    }
+    std::format_to(std::back_inserter(out), "--- {}\n+++ {}\n", aName, bName);
+
+    // 相距不超过 2 * context 行的改动合并为同一个 hunk
+    size_t first = 0;
+    while (first < chunks.size()) {
+        size_t last = first;
+        while (last + 1 < chunks.size() &&
+               chunks[last + 1].aPos - (chunks[last].aPos + chunks[last].aLen) <= 2 * context) {
+            ++last;
+        }
+        size_t aStart = chunks[first].aPos - std::min(context, chunks[first].aPos);
+        size_t bStart = chunks[first].bPos - (chunks[first].aPos - aStart);
+        size_t aEnd = std::min(la.size(), chunks[last].aPos + chunks[last].aLen + context);
+        size_t bEnd = chunks[last].bPos + chunks[last].bLen + (aEnd - chunks[last].aPos - chunks[last].aLen);
+
+        out.append("@@ -");
+        append_range(out, aStart, aEnd - aStart);
+        out.append(" +");
+        append_range(out, bStart, bEnd - bStart);
+        out.append(" @@\n");
+
+        size_t i = aStart;
+        for (size_t c = first; c <= last; ++c) {
+            for (; i < chunks[c].aPos; ++i) {
+                append_line(out, ' ', la[i]);
+            }
+            for (size_t k = 0; k < chunks[c].aLen; ++k) {
+                append_line(out, '-', la[chunks[c].aPos + k]);
+            }
+            for (size_t k = 0; k < chunks[c].bLen; ++k) {
+                append_line(out, '+', lb[chunks[c].bPos + k]);
+            }
+            i = chunks[c].aPos + chunks[c].aLen;
+        }
+        for (; i < aEnd; ++i) {
+            append_line(out, ' ', la[i]);
+        }
+        first = last + 1;
+    }
+}
+
+void append_conflict(std::string& out, std::string_view a, std::string_view b) {
+    out.append(CONFLICT_BEGIN);
+    append_text(out, a);
+    out.append(CONFLICT_SEP);
+    append_text(out, b);
+    out.append(CONFLICT_END);
+}
+
+bool merge3(std::string_view base, std::string_view a, std::string_view b, std::string& out) {
+    auto lo = split_lines(base);
+    auto la = split_lines(a);
+    auto lb = split_lines(b);
+    auto ca = diff_lines(lo, la);
+    auto cb = diff_lines(lo, lb);
+
+    // 输出一次性预留：最坏情况下两侧全文都进入冲突块
+    out.reserve(out.size() + a.size() + b.size() + CONFLICT_BEGIN.size() + CONFLICT_SEP.size() + CONFLICT_END.size() +
+                2);
+
+    bool clean = true;
+    size_t pos = 0;     // base 中已输出到的位置
+    ptrdiff_t da = 0;   // a 相对 base 的行号偏移（当前组之前）
+    ptrdiff_t db = 0;   // b 相对 base 的行号偏移
+    size_t ia = 0;
+    size_t ib = 0;
+    while (ia < ca.size() || ib < cb.size()) {
+        // 取起点更早的改动开一个组，再吸收所有与之重叠的改动
+        bool fromA = ib == cb.size() || (ia < ca.size() && ca[ia].aPos <= cb[ib].aPos);
+        const Chunk& first = fromA ? ca[ia] : cb[ib];
+        size_t start = first.aPos;
+        size_t end = first.aPos + first.aLen;
+        bool emptyAtEnd = first.aLen == 0;
+        ptrdiff_t growA = 0;
+        ptrdiff_t growB = 0;
+        bool touchedA = false;
+        bool touchedB = false;
+        while (true) {
+            // 区间相交即重叠；恰好相接时只有一侧是纯插入才算（插入顺序无法确定）
+            auto joins = [&](const Chunk& c) {
+                return c.aPos < end || (c.aPos == end && (c.aLen == 0 || emptyAtEnd));
+            };
+            const Chunk* next = nullptr;
+            bool nextA = false;
+            if (ia < ca.size() && joins(ca[ia])) {
+                next = &ca[ia];
+                nextA = true;
+            } else if (ib < cb.size() && joins(cb[ib])) {
+                next = &cb[ib];
+            }
+            if (next == nullptr) {
+                break;
+            }
+            size_t nextEnd = next->aPos + next->aLen;
+            if (nextEnd > end) {
+                end = nextEnd;
+                emptyAtEnd = next->aLen == 0;
+            } else if (nextEnd == end && next->aLen == 0) {
+                emptyAtEnd = true;
+            }
+            auto grow = static_cast<ptrdiff_t>(next->bLen) - static_cast<ptrdiff_t>(next->aLen);
+            if (nextA) {
+                growA += grow;
+                touchedA = true;
+                ++ia;
+            } else {
+                growB += grow;
+                touchedB = true;
+                ++ib;
+            }
+        }
+
+        out.append(span(lo, pos, start));
+        auto sideA = span(la, start + da, end + da + growA);
+        auto sideB = span(lb, start + db, end + db + growB);
+        if (!touchedB) {
+            out.append(sideA);
+        } else if (!touchedA || sideA == sideB) {
+            out.append(sideB);
+        } else {
+            clean = false;
+            append_conflict(out, sideA, sideB);
+        }
+        pos = end;
+        da += growA;
+        db += growB;
+    }
+    out.append(span(lo, pos, lo.size()));
+    return clean;
+}
+
+} // namespace diff
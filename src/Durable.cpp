@@ -0,0 +1,259 @@
+#include "Durable.h"
+#include "GitliteException.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <format>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace durable {
+
+namespace {
+
+Transaction* active = nullptr;
+
+void sync_path(const fs::path& p) {
+    int fd = ::open(p.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::invalid_argument("cannot open file");
+    }
+    int rc = ::fsync(fd);
+    ::close(fd);
+    if (rc != 0) {
+        throw std::invalid_argument("cannot sync file");
+    }
+}
+
+void sync_parent(const fs::path& p) {
+    auto dir = p.parent_path();
+    sync_path(dir.empty() ? fs::path(".") : dir);
+}
+
+// 一次调用把临时文件所在文件系统上的全部脏数据写回。
+// 一个事务只写同一个仓库目录，临时文件都在同一个文件系统上
+void sync_all(const std::vector<std::pair<fs::path, fs::path>>& files) {
+#ifdef __linux__
+    auto dir = files.front().first.parent_path();
+    int fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw std::invalid_argument("cannot open directory");
+    }
+    int rc = ::syncfs(fd);
+    ::close(fd);
+    if (rc != 0) {
+        throw std::invalid_argument("cannot sync file system");
+    }
+#else
+    for (const auto& [tmp, _] : files) {
+        sync_path(tmp);
+    }
+#endif
+}
+
+std::set<fs::path> heldLocks; // 已持有、尚未提交或释放的锁文件
+
+// std::exit 不会析构栈上对象：退出时提交进行中的事务，并删除仍持有的锁
+void finish_at_exit() {
+    if (active != nullptr) {
+        active->commit();
+    }
+    for (const auto& lock : heldLocks) {
+        std::error_code ec;
+        fs::remove(lock, ec);
+    }
+}
+
+void ensure_exit_hook() {
+    static const bool registered = [] { return std::atexit(finish_at_exit) == 0; }();
+    (void)registered;
+}
+
+} // namespace
+
+Mode mode() {
+    static const Mode cached = [] {
+        const char* env = std::getenv("GITLITE_FSYNC");
+        std::string value = env != nullptr ? env : "";
+        if (value == "none") {
+            return Mode::None;
+        }
+        if (value == "full") {
+            return Mode::Full;
+        }
+        return Mode::Batch;
+    }();
+    return cached;
+}
+
+void sync_file(const fs::path& file) {
+    sync_path(file);
+}
+
+fs::path temp_path(const fs::path& target) {
+    auto tmp = target;
+    tmp += ".tmp-" + std::to_string(::getpid());
+    return tmp;
+}
+
+void publish(const fs::path& tmp, const fs::path& target) {
+    if (active != nullptr) {
+        // 同一事务内重复写同一目标时只保留最后一次
+        for (auto& [oldTmp, oldTarget] : active->staged) {
+            if (oldTarget == target) {
+                if (oldTmp != tmp) {
+                    fs::remove(oldTmp);
+                    oldTmp = tmp;
+                }
+                return;
+            }
+        }
+        active->staged.emplace_back(tmp, target);
+        return;
+    }
+    // 事务之外的零散写入（工作区文件、批量传输的对象）只在 Full 模式下逐个落盘
+    if (mode() == Mode::Full) {
+        sync_path(tmp);
+    }
+    fs::rename(tmp, target);
+    if (mode() == Mode::Full) {
+        sync_parent(target);
+    }
+}
+
+void write_file(const fs::path& target, const writer& write) {
+    auto tmp = temp_path(target);
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::invalid_argument("cannot open file");
+        }
+        write(file);
+        file.close();
+        if (!file) {
+            fs::remove(tmp);
+            throw std::invalid_argument("cannot write file");
+        }
+    }
+    publish(tmp, target);
+}
+
+void write_file(const fs::path& target, std::string_view content) {
+    write_file(target, [content](std::ostream& out) {
+        out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    });
+}
+
+FileLock::FileLock(fs::path file) : target(std::move(file)), lock(target) {
+    using namespace std::chrono_literals;
+    lock += ".lock";
+    auto delay = 1ms;
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (true) {
+        int fd = ::open(lock.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            ::close(fd);
+            ensure_exit_hook();
+            heldLocks.insert(lock);
+            held = true;
+            return;
+        }
+        if (errno != EEXIST || std::chrono::steady_clock::now() >= deadline) {
+            throw GitliteException(std::format(
+                "Unable to lock {}: another gitlite process is running. If not, remove {}.", target.string(), lock.string()));
+        }
+        std::this_thread::sleep_for(delay);
+        delay = std::min(delay * 2, std::chrono::milliseconds(50));
+    }
+}
+
+FileLock::~FileLock() {
+    release();
+}
+
+void FileLock::commit(const writer& write) {
+    {
+        std::ofstream file(lock, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::invalid_argument("cannot open file");
+        }
+        write(file);
+        file.close();
+        if (!file) {
+            throw std::invalid_argument("cannot write file");
+        }
+    }
+    // 改名之后锁文件不复存在，锁随之释放
+    held = false;
+    heldLocks.erase(lock);
+    publish(lock, target);
+}
+
+void FileLock::release() {
+    if (held) {
+        held = false;
+        heldLocks.erase(lock);
+        std::error_code ec;
+        fs::remove(lock, ec);
+    }
+}
+
+Transaction::Transaction() {
+    if (active == nullptr) {
+        ensure_exit_hook();
+        active = this;
+        outer = true;
+    }
+}
+
+Transaction::~Transaction() {
+    if (!outer || active != this) {
+        return;
+    }
+    active = nullptr;
+    for (const auto& [tmp, _] : staged) {
+        std::error_code ec;
+        fs::remove(tmp, ec);
+    }
+}
+
+void Transaction::commit() {
+    if (!outer || active != this) {
+        return;
+    }
+    active = nullptr;
+    auto files = std::move(staged);
+    staged.clear();
+    if (files.empty()) {
+        return;
+    }
+    switch (mode()) {
+    case Mode::None: break;
+    case Mode::Batch: sync_all(files); break;
+    case Mode::Full:
+        for (const auto& [tmp, _] : files) {
+            sync_path(tmp);
+        }
+        break;
+    }
+    std::set<fs::path> dirs;
+    for (const auto& [tmp, target] : files) {
+        fs::rename(tmp, target);
+        dirs.insert(target.parent_path());
+    }
+    if (mode() == Mode::Full) {
+        for (const auto& dir : dirs) {
+            sync_path(dir.empty() ? fs::path(".") : dir);
+        }
+    }
+}
+
+} // namespace durable
@@ -9,6 +9,10 @@ void GitEngine::init() {
     repo.init();
 }
 
+void GitEngine::clone(con_string source, con_string directory, int depth, bool blobless, bool shared) {
+    repo.clone(source, directory, depth, blobless, shared);
+}
+
 void GitEngine::add(con_string filename) {
     repo.git_add(filename);
 }
@@ -21,18 +25,22 @@ void GitEngine::rm(con_string filename) {
     repo.git_rm(filename);
 }
 
-void GitEngine::log() {
-    repo.git_log();
+void GitEngine::log(const LogOptions& options) {
+    repo.git_log(options);
 }
 
-void GitEngine::globalLog() {
-    repo.global_log();
+void GitEngine::globalLog(const LogOptions& options) {
+    repo.global_log(options);
 }
 
 void GitEngine::find(con_string message) {
     repo.find(message);
 }
 
+void GitEngine::findGrep(con_string pattern) {
+    repo.find_grep(pattern);
+}
+
 void GitEngine::checkoutBranch(con_string branch) {
     repo.checkout_branch(branch);
 }
@@ -48,6 +56,10 @@ void GitEngine::status() {
     repo.status();
 }
 
+void GitEngine::diff(const std::vector<std::string>& revs, bool cached) {
+    repo.diff(revs, cached);
+}
+
 void GitEngine::branch(con_string name) {
     repo.branch(name);
 }
@@ -63,3 +75,62 @@ void GitEngine::reset(con_string commitId) {
 void GitEngine::merge(con_string branch) {
     repo.merge(branch);
 }
+
+void GitEngine::addRemote(con_string name, con_string path) {
+    repo.add_remote(name, path);
+}
+
+void GitEngine::rmRemote(con_string name) {
+    repo.rm_remote(name);
+}
+
+void GitEngine::push(con_string remoteName, con_string remoteBranch) {
+    repo.push(remoteName, remoteBranch);
+}
+
+void GitEngine::fetch(con_string remoteName, con_string remoteBranch) {
+    repo.fetch(remoteName, remoteBranch);
+}
+
+void GitEngine::pull(con_string remoteName, con_string remoteBranch) {
+    repo.pull(remoteName, remoteBranch);
+}
+
+void GitEngine::bundleCreate(con_string file,
+                             con_string branch,
+                             const std::optional<std::string>& base,
+                             bool compress) {
+    repo.bundle_create(file, branch, base, compress);
+}
+
+void GitEngine::unbundle(con_string file) {
+    repo.bundle_unbundle(file);
+}
+
+void GitEngine::bitmap() {
+    repo.build_bitmaps();
+}
+
+void GitEngine::packRefs() {
+    repo.pack_refs();
+}
+
+void GitEngine::sparseSet(const std::vector<std::string>& dirs) {
+    repo.sparse_set(dirs);
+}
+
+void GitEngine::sparseList() {
+    repo.sparse_list();
+}
+
+void GitEngine::sparseDisable() {
+    repo.sparse_disable();
+}
+
+void GitEngine::gc(std::chrono::system_clock::time_point expire) {
+    repo.gc(expire);
+}
+
+void GitEngine::fsck(bool quick) {
+    repo.fsck(quick);
+}
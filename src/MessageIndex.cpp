@@ -0,0 +1,180 @@
+#include "MessageIndex.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char HEX[] = "0123456789abcdef";
+
+std::string trigram_name(std::string_view s) {
+    std::string name;
+    for (unsigned char c : s) {
+        name.push_back(HEX[c >> 4]);
+        name.push_back(HEX[c & 0xf]);
+    }
+    return name;
+}
+
+std::set<std::string> trigrams(std::string_view text) {
+    std::set<std::string> grams;
+    for (size_t i = 0; i + 3 <= text.size(); ++i) {
+        grams.insert(trigram_name(text.substr(i, 3)));
+    }
+    return grams;
+}
+
+// 从 ECMAScript 正则中取出每个匹配都必然包含的字面量片段。
+// 顶层有选择分支时无法保证任何字面量，返回 nullopt。
+std::optional<std::vector<std::string>> required_literals(std::string_view p) {
+    std::vector<std::string> runs;
+    std::string cur;
+    auto flush = [&] {
+        if (cur.size() >= 3) {
+            runs.push_back(cur);
+        }
+        cur.clear();
+    };
+    // 跳过括号内的内容（可能是可选的分组或字符类）
+    auto skip_to = [&](size_t& i, char open, char close) {
+        int depth = 0;
+        for (; i < p.size(); ++i) {
+            if (p[i] == '\\') {
+                ++i;
+            } else if (p[i] == open && (open != '[' || depth == 0)) {
+                ++depth;
+            } else if (p[i] == close && --depth == 0) {
+                return;
+            }
+        }
+    };
+    for (size_t i = 0; i < p.size(); ++i) {
+        char c = p[i];
+        if (c == '*' || c == '?' || c == '{') {
+            // 数量词让前一个字符变为可选
+            if (!cur.empty()) {
+                cur.pop_back();
+            }
+            flush();
+            if (c == '{') {
+                skip_to(i, '{', '}');
+            }
+        } else if (c == '+' || c == '.' || c == '^' || c == '$') {
+            flush();
+        } else if (c == '|') {
+            return std::nullopt;
+        } else if (c == '(') {
+            flush();
+            skip_to(i, '(', ')');
+        } else if (c == '[') {
+            flush();
+            skip_to(i, '[', ']');
+        } else if (c == '\\' && i + 1 < p.size()) {
+            char e = p[++i];
+            if (!std::isalnum(static_cast<unsigned char>(e))) {
+                cur.push_back(e);
+                continue;
+            }
+            // 字母数字转义都不当作字面量；带操作数的（\xHH \uHHHH \cX、反向引用）连操作数一起跳过，
+            // 否则操作数会被误当成必需的字面量
+            flush();
+            if (e == 'x' || e == 'u' || e == 'c') {
+                i += e == 'x' ? 2 : e == 'u' ? 4 : 1;
+            } else if (std::isdigit(static_cast<unsigned char>(e))) {
+                while (i + 1 < p.size() && std::isdigit(static_cast<unsigned char>(p[i + 1]))) {
+                    ++i;
+                }
+            } else if (std::string_view("dDwWsSbBfnrtv").find(e) == std::string_view::npos) {
+                return std::nullopt; // 不认识的转义：退回全量扫描
+            }
+        } else {
+            cur.push_back(c);
+        }
+    }
+    flush();
+    return runs;
+}
+
+} // namespace
+
+MessageIndex::MessageIndex(const fs::path& gitDir) : root(gitDir / "msgindex") {}
+
+bool MessageIndex::exists() const {
+    return fs::is_directory(root);
+}
+
+void MessageIndex::create() const {
+    fs::create_directories(root / "exact");
+    fs::create_directories(root / "tri");
+}
+
+std::vector<std::string> MessageIndex::postings(const fs::path& file) const {
+    std::vector<std::string> ids;
+    if (!fs::exists(file)) {
+        return ids;
+    }
+    std::string raw;
+    Utils::readContentsAsString(raw, file);
+    constexpr size_t len = Utils::UID_LENGTH;
+    for (size_t i = 0; i + len <= raw.size(); i += len) {
+        ids.emplace_back(raw, i, len);
+    }
+    std::ranges::sort(ids);
+    auto dup = std::ranges::unique(ids);
+    ids.erase(dup.begin(), dup.end());
+    return ids;
+}
+
+void MessageIndex::add(const std::vector<std::pair<std::string, std::string>>& entries) const {
+    std::map<fs::path, std::string> appends;
+    for (const auto& [id, message] : entries) {
+        std::string key = SHA1::sha1(message);
+        appends[root / "exact" / key.substr(0, 2) / key.substr(2)].append(id);
+        for (const auto& gram : trigrams(message)) {
+            appends[root / "tri" / gram.substr(0, 2) / gram.substr(2)].append(id);
+        }
+    }
+    for (const auto& [file, ids] : appends) {
+        fs::create_directories(file.parent_path());
+        std::ofstream out(file, std::ios::binary | std::ios::app);
+        out.write(ids.data(), static_cast<std::streamsize>(ids.size()));
+    }
+}
+
+std::vector<std::string> MessageIndex::exact(std::string_view message) const {
+    std::string key = SHA1::sha1(std::string(message));
+    return postings(root / "exact" / key.substr(0, 2) / key.substr(2));
+}
+
+std::optional<std::vector<std::string>> MessageIndex::candidates(std::string_view pattern) const {
+    auto literals = required_literals(pattern);
+    if (!literals || literals->empty()) {
+        return std::nullopt;
+    }
+    std::set<std::string> grams;
+    for (const auto& lit : *literals) {
+        grams.merge(trigrams(lit));
+    }
+    // 先取最短的倒排表，逐个求交，结果为空时提前结束
+    std::vector<std::vector<std::string>> lists;
+    for (const auto& gram : grams) {
+        lists.push_back(postings(root / "tri" / gram.substr(0, 2) / gram.substr(2)));
+        if (lists.back().empty()) {
+            return std::vector<std::string>{};
+        }
+    }
+    std::ranges::sort(lists, [](const auto& x, const auto& y) { return x.size() < y.size(); });
+    std::vector<std::string> result = std::move(lists.front());
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        std::vector<std::string> next;
+        std::ranges::set_intersection(result, lists[i], std::back_inserter(next));
+        result = std::move(next);
+    }
+    return result;
+}
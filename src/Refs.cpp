@@ -0,0 +1,167 @@
+#include "Refs.h"
+#include "Durable.h"
+#include "Serialization.hpp"
+#include "Utils.h"
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 剩余区间小于这个字节数时改为顺序扫描
+constexpr std::streamoff SCAN_WINDOW = 4096;
+
+// 一行是 "<40 位 ID> <名称>"
+bool parse_line(const std::string& line, std::string_view& name, std::string_view& id) {
+    if (line.size() <= Utils::UID_LENGTH + 1 || line[Utils::UID_LENGTH] != ' ') {
+        return false;
+    }
+    id = std::string_view(line).substr(0, Utils::UID_LENGTH);
+    name = std::string_view(line).substr(Utils::UID_LENGTH + 1);
+    return true;
+}
+
+} // namespace
+
+fs::path RefStore::loose_path(std::string_view name) const {
+    return git / "refs" / "heads" / name;
+}
+
+std::optional<std::string> RefStore::read(std::string_view name) const {
+    auto loose = loose_path(name);
+    if (fs::is_regular_file(loose)) {
+        std::string id;
+        ser::deserialize_from_file(id, loose);
+        return id;
+    }
+    return read_packed(name);
+}
+
+std::optional<std::string> RefStore::read_packed(std::string_view name) const {
+    std::ifstream in(packed_file(), std::ios::binary);
+    if (!in.is_open()) {
+        return std::nullopt;
+    }
+    in.seekg(0, std::ios::end);
+    std::streamoff lo = 0;
+    std::streamoff hi = in.tellg();
+    std::string line;
+    std::string_view lineName;
+    std::string_view lineId;
+    // 不变式：lo 是某一行的开头，目标行（若存在）开头位于 [lo, hi)
+    while (hi - lo > SCAN_WINDOW) {
+        std::streamoff mid = lo + (hi - lo) / 2;
+        in.clear();
+        in.seekg(mid - 1);
+        std::getline(in, line); // 跳到 mid 之后第一个行首
+        std::streamoff start = in.tellg();
+        if (!in || start >= hi) {
+            hi = mid;
+            continue;
+        }
+        if (!std::getline(in, line) || !parse_line(line, lineName, lineId)) {
+            throw std::invalid_argument("corrupt packed-refs");
+        }
+        if (lineName == name) {
+            return std::string(lineId);
+        }
+        if (lineName < name) {
+            lo = in.tellg();
+            if (lo < 0) {
+                return std::nullopt; // 已是最后一行
+            }
+        } else {
+            hi = start;
+        }
+    }
+    in.clear();
+    in.seekg(lo);
+    while (in.tellg() < hi && std::getline(in, line)) {
+        if (parse_line(line, lineName, lineId) && lineName == name) {
+            return std::string(lineId);
+        }
+    }
+    return std::nullopt;
+}
+
+std::map<std::string, std::string> RefStore::read_all_packed() const {
+    std::map<std::string, std::string> refs;
+    std::ifstream in(packed_file(), std::ios::binary);
+    std::string line;
+    std::string_view name;
+    std::string_view id;
+    while (std::getline(in, line)) {
+        if (parse_line(line, name, id)) {
+            refs.emplace(name, id);
+        }
+    }
+    return refs;
+}
+
+std::map<std::string, std::string> RefStore::list() const {
+    auto refs = read_all_packed();
+    auto heads = git / "refs" / "heads";
+    if (fs::is_directory(heads)) {
+        for (const auto& entry : fs::recursive_directory_iterator(heads)) {
+            // 跳过正在写入的锁文件和临时文件
+            auto file = entry.path().filename().string();
+            if (!entry.is_regular_file() || file.ends_with(".lock") || file.find(".tmp-") != std::string::npos) {
+                continue;
+            }
+            std::string id;
+            ser::deserialize_from_file(id, entry.path());
+            refs[entry.path().lexically_relative(heads).generic_string()] = std::move(id);
+        }
+    }
+    return refs;
+}
+
+void RefStore::remove(std::string_view name) {
+    if (fs::is_regular_file(loose_path(name))) {
+        durable::FileLock lock(loose_path(name));
+        fs::remove(loose_path(name));
+    }
+    if (read_packed(name)) {
+        durable::FileLock lock(packed_file());
+        auto refs = read_all_packed();
+        refs.erase(std::string(name));
+        lock.commit([&refs](std::ostream& out) {
+            for (const auto& [n, id] : refs) {
+                out << id << ' ' << n << '\n';
+            }
+        });
+    }
+}
+
+size_t RefStore::pack() {
+    durable::FileLock lock(packed_file());
+    auto refs = read_all_packed();
+    auto all = list();
+    std::map<std::string, std::string> folded;
+    for (auto& [name, id] : all) {
+        if (fs::is_regular_file(loose_path(name))) {
+            folded.emplace(name, id);
+        }
+        refs[name] = std::move(id);
+    }
+    lock.commit([&refs](std::ostream& out) {
+        for (const auto& [name, id] : refs) {
+            out << id << ' ' << name << '\n';
+        }
+    });
+    // packed-refs 已经落盘：逐个锁住松散引用，值未变才删除
+    size_t removed = 0;
+    for (const auto& [name, id] : folded) {
+        durable::FileLock looseLock(loose_path(name));
+        if (!fs::is_regular_file(loose_path(name))) {
+            continue;
+        }
+        std::string current;
+        ser::deserialize_from_file(current, loose_path(name));
+        if (current == id) {
+            fs::remove(loose_path(name));
+            ++removed;
+        }
+    }
+    return removed;
+}
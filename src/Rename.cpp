@@ -0,0 +1,193 @@
+#include "Rename.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace diff {
+
+namespace {
+
+constexpr int BANDS = 16;
+constexpr int ROWS = 2;
+constexpr int K = BANDS * ROWS;
+
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t fnv1a(std::string_view s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+struct Fingerprint {
+    std::string path;
+    std::vector<uint64_t> lines; // 去重并排序后的行哈希
+    std::array<uint64_t, K> sig{};
+};
+
+Fingerprint fingerprint(const std::string& path, std::string_view text) {
+    Fingerprint fp{path, {}, {}};
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        end = end == std::string_view::npos ? text.size() : end;
+        auto line = text.substr(start, end - start);
+        // 换行风格不影响相似度
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        fp.lines.push_back(fnv1a(line));
+        start = end + 1;
+    }
+    std::ranges::sort(fp.lines);
+    auto dup = std::ranges::unique(fp.lines);
+    fp.lines.erase(dup.begin(), dup.end());
+
+    fp.sig.fill(UINT64_MAX);
+    for (uint64_t h : fp.lines) {
+        for (int i = 0; i < K; ++i) {
+            fp.sig[i] = std::min(fp.sig[i], mix64(h ^ mix64(i + 1)));
+        }
+    }
+    return fp;
+}
+
+uint64_t band_key(const Fingerprint& fp, int band) {
+    uint64_t key = mix64(band + 0x9e3779b97f4a7c15ULL);
+    for (int r = 0; r < ROWS; ++r) {
+        key = mix64(key ^ fp.sig[band * ROWS + r]);
+    }
+    return key;
+}
+
+// 候选对才计算精确的 Jaccard 相似度
+int score(const Fingerprint& a, const Fingerprint& b) {
+    size_t common = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.lines.size() && j < b.lines.size()) {
+        if (a.lines[i] == b.lines[j]) {
+            ++common;
+            ++i;
+            ++j;
+        } else if (a.lines[i] < b.lines[j]) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    size_t total = a.lines.size() + b.lines.size() - common;
+    return total == 0 ? 0 : static_cast<int>(common * 100 / total);
+}
+
+} // namespace
+
+std::vector<RenamePair> detect_renames(const std::map<std::string, std::string>& deleted,
+                                       const std::map<std::string, std::string>& added,
+                                       const blob_loader& loadSource,
+                                       const blob_loader& loadTarget,
+                                       int minScore) {
+    std::vector<RenamePair> pairs;
+    std::unordered_set<std::string> usedSources;
+    std::unordered_set<std::string> usedTargets;
+
+    // 1. 完全相同的 blob：不读取任何内容
+    std::unordered_multimap<std::string, const std::string*> byBlob;
+    for (const auto& [path, id] : deleted) {
+        byBlob.emplace(id, &path);
+    }
+    for (const auto& [path, id] : added) {
+        auto it = byBlob.find(id);
+        if (it != byBlob.end()) {
+            pairs.push_back({*it->second, path, 100});
+            usedSources.insert(*it->second);
+            usedTargets.insert(path);
+            byBlob.erase(it);
+        }
+    }
+
+    // 2. 其余文件：MinHash 签名 + LSH 分桶，只对同桶的候选对打分
+    std::vector<Fingerprint> sources;
+    for (const auto& [path, id] : deleted) {
+        if (!usedSources.contains(path)) {
+            sources.push_back(fingerprint(path, loadSource(path, id)));
+        }
+    }
+    if (sources.empty()) {
+        return pairs;
+    }
+    std::unordered_map<uint64_t, std::vector<size_t>> buckets;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        if (sources[s].lines.empty()) {
+            continue;
+        }
+        for (int band = 0; band < BANDS; ++band) {
+            buckets[band_key(sources[s], band)].push_back(s);
+        }
+    }
+
+    struct Candidate {
+        int score;
+        size_t source;
+        std::string target;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto& [path, id] : added) {
+        if (usedTargets.contains(path)) {
+            continue;
+        }
+        auto target = fingerprint(path, loadTarget(path, id));
+        if (target.lines.empty()) {
+            continue;
+        }
+        std::unordered_set<size_t> seen;
+        for (int band = 0; band < BANDS; ++band) {
+            auto it = buckets.find(band_key(target, band));
+            if (it == buckets.end()) {
+                continue;
+            }
+            for (size_t s : it->second) {
+                if (!seen.insert(s).second) {
+                    continue;
+                }
+                int sc = score(sources[s], target);
+                if (sc >= minScore) {
+                    candidates.push_back({sc, s, path});
+                }
+            }
+        }
+    }
+
+    // 3. 按得分从高到低贪心配对
+    std::ranges::sort(candidates, [&](const Candidate& x, const Candidate& y) {
+        if (x.score != y.score) {
+            return x.score > y.score;
+        }
+        return std::tie(sources[x.source].path, x.target) < std::tie(sources[y.source].path, y.target);
+    });
+    for (const auto& c : candidates) {
+        const auto& src = sources[c.source].path;
+        if (usedTargets.contains(c.target) || usedSources.contains(src)) {
+            continue;
+        }
+        pairs.push_back({src, c.target, c.score});
+        usedTargets.insert(c.target);
+        usedSources.insert(src);
+    }
+    return pairs;
+}
+
+} // namespace diff
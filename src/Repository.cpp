@@ -1,17 +1,34 @@
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
 #include <optional>
 #include <queue>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "Bundle.h"
 #include "Commit.hpp"
+#include "CommitScanner.h"
+#include "Diff.h"
+#include "Durable.h"
+#include "GitliteException.h"
+#include "LogFormat.h"
+#include "MessageIndex.h"
+#include "Rename.h"
 #include "Repository.h"
 #include "Serialization.hpp"
+#include "StatCache.h"
+#include "Untracked.h"
 #include "Utils.h"
 
 using std::cout;
@@ -27,32 +44,102 @@ const fs::path Repo::gitDir = ".gitlite";
 const fs::path Repo::objDir = ".gitlite/objects";
 const fs::path Repo::branchDir = ".gitlite/refs/heads";
 const fs::path Repo::headFile = ".gitlite/HEAD";
+const fs::path Repo::indexDeltaFile = ".gitlite/INDEX_DELTA";
 const fs::path Repo::commitSetFile = ".gitlite/COMMITS";
-const fs::path Repo::branchSetFile = ".gitlite/BRANCHES";
+const fs::path Repo::remoteSetFile = ".gitlite/REMOTES";
+const fs::path Repo::shallowFile = ".gitlite/SHALLOW";
+const fs::path Repo::promisorFile = ".gitlite/PROMISOR";
+const fs::path Repo::alternatesFile = ".gitlite/ALTERNATES";
+const fs::path Repo::objectFilterFile = ".gitlite/OBJECT_FILTER";
+const fs::path Repo::sparseFile = ".gitlite/SPARSE";
+const fs::path Repo::sparseIndexFile = ".gitlite/SPARSE_INDEX";
+const fs::path Repo::sparseTreeDir = ".gitlite/sparse";
+const fs::path Repo::untrackedFile = ".gitlite/UNTRACKED";
+const fs::path Repo::statFile = ".gitlite/STAT";
 
 inline fs::path Repo::id_to_dir(string_view id) {
     return objDir / id.substr(0, 2) / id.substr(2, 38);
 }
 
-void Repo::add_commit(const Commit& comm) {
-    string id = comm.id;
-    ser::serialize_to_file(comm, id_to_dir(id));
+inline fs::path Repo::id_to_dir(const path& git, string_view id) {
+    return git / "objects" / id.substr(0, 2) / id.substr(2, 38);
 }
 
-void Repo::update_branch(string_view branch, string_view comm_id) {
-    ser::serialize_to_safe_file(comm_id, branchDir / branch);
+string Repo::add_commit(Commit& comm, const durable::writer& mapping) {
+    // ID 位于文件开头，却是其余字节的哈希：先写占位 ID，正文只序列化一次，
+    // 同时送入 SHA-1 与文件，最后回填 ID 并改名到 ID 对应的路径
+    const path tmp = durable::temp_path(objDir / "COMMIT");
+    std::ofstream file(tmp, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::invalid_argument("cannot create file");
+    }
+    ser::serialize(string(Utils::UID_LENGTH, '0'), file);
+    SHA1::Context ctx;
+    {
+        ser::sink_buf buf({[&](string_view chunk) { ctx.update(chunk); },
+                           [&](string_view chunk) {
+                               file.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+                           }});
+        std::ostream out(&buf);
+        if (mapping) {
+            serialize_header_body(comm, out);
+            mapping(out);
+        } else {
+            serialize_body(comm, out);
+        }
+    }
+    comm.id = ctx.digest();
+    file.seekp(sizeof(size_t));
+    file.write(comm.id.data(), static_cast<std::streamsize>(comm.id.size()));
+    file.close();
+    if (!file) {
+        throw std::invalid_argument("cannot write file");
+    }
+    auto target = id_to_dir(comm.id);
+    fs::create_directories(target.parent_path());
+    durable::publish(tmp, target);
+    record_objects(gitDir, {comm.id});
+    return comm.id;
+}
+
+bool Repo::decode_commit(const string& bytes, string_view id, Commit& comm, bool rehash) {
+    std::istringstream in(bytes);
+    deserialize(comm, in);
+    if (!in || in.peek() != std::char_traits<char>::eof() || comm.id != id) {
+        return false;
+    }
+    // 提交的 ID 是去掉开头 ID 字段后其余字节的哈希
+    return !rehash || SHA1::sha1(bytes.substr(sizeof(size_t) + comm.id.size())) == id;
+}
+
+bool Repo::update_ref(const path& git, string_view name, string_view comm_id, const std::optional<string>& expected) {
+    RefStore store(git);
+    auto ref = store.loose_path(name);
+    fs::create_directories(ref.parent_path());
+    durable::FileLock lock(ref);
+    // 当前值可能只在 packed-refs 中；pack 删除松散引用前会先取得同一把锁
+    if (expected && store.read(name).value_or("") != *expected) {
+        return false;
+    }
+    lock.commit([comm_id](std::ostream& out) { ser::serialize(comm_id, out); });
+    return true;
+}
+
+void Repo::update_branch(string_view branch, string_view comm_id, const std::optional<string>& expected) {
+    if (!update_ref(gitDir, branch, comm_id, expected)) {
+        throw GitliteException(format("Branch {} was updated by another process.", branch));
+    }
 }
 
 void Repo::update_head(string_view branch) {
-    ser::serialize_to_safe_file(branch, headFile);
+    durable::FileLock lock(headFile);
+    lock.commit([branch](std::ostream& out) { ser::serialize(branch, out); });
 }
 
 void Repo::add_init_commit() {
+    durable::Transaction tx;
     Commit initial = make_init_commit();
-    string id = SHA1::sha1(serialize(initial));
-    initial.id = id;
-    add_commit(initial);
-    allBranches.emplace("master");
+    string id = add_commit(initial);
     update_branch("master", id);
     update_head("master");
     // headCommitId = id;
@@ -60,23 +147,37 @@ void Repo::add_init_commit() {
     // branches.emplace("master", id);
     allCommits.insert(id);
     persist_commit_set();
-    persist_branch_set();
+    tx.commit();
+    index_messages(gitDir, {{id, initial.message}});
 }
 
-void Repo::init() {
-    if (fs::exists(gitDir)) {
-        Utils::exitWithMessage("A Gitlite version-control system already exists in the current directory.");
-    }
+void Repo::create_layout() {
     fs::create_directory(gitDir);
     fs::create_directories(objDir); // 仿照 git 的做法，commit 和 blob 放在一起
     fs::create_directories(branchDir);
     fs::create_directories(gitDir / "refs" / "remotes");
+    MessageIndex(gitDir).create();
+    bloom::Filter::create(objectFilterFile, {});
+    object_filter(gitDir) = bloom::Filter(objectFilterFile);
+}
+
+void Repo::init() {
+    if (fs::exists(gitDir)) {
+        Utils::exitWithMessage("A Gitlite version-control system already exists in the current directory.");
+    }
+    create_layout();
     add_init_commit();
 }
 
 void Repo::recover_basic_info() {
     ser::deserialize_from_file(headBranch, headFile);
-    ser::deserialize_from_file(headCommitId, branchDir / headBranch);
+    headCommitId = refs.read(headBranch).value();
+}
+
+void Repo::lock_index() {
+    if (!indexLock) {
+        indexLock.emplace(gitDir / "INDEX");
+    }
 }
 
 void Repo::recover_index() {
@@ -93,6 +194,64 @@ void Repo::recover_index() {
     } else {
         stageRemove.clear();
     }
+    // 在基础文件之上重放增量记录；末尾写了一半的记录读不完整，直接忽略
+    indexDelta = 0;
+    std::ifstream delta(indexDeltaFile, std::ios::binary);
+    char op = 0;
+    string name;
+    string blobId;
+    while (delta.read(&op, 1)) {
+        ser::deserialize(name, delta);
+        ser::deserialize(blobId, delta);
+        if (!delta) {
+            break;
+        }
+        ++indexDelta;
+        if (op == 'A') {
+            stageAdd[name] = blobId;
+            stageRemove.erase(name);
+        } else if (op == 'U') {
+            stageAdd.erase(name);
+            stageRemove.erase(name);
+        } else if (op == 'R') {
+            stageAdd.erase(name);
+            stageRemove.insert(name);
+        }
+    }
+}
+
+void Repo::persist_index() {
+    lock_index();
+    // 按写入顺序改名（在事务中也是如此）：基础文件先于清空的增量生效
+    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
+    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    durable::write_file(indexDeltaFile, string_view());
+    indexDelta = 0;
+}
+
+void Repo::append_index(char op, con_string fileName, string_view blobId) {
+    // 增量超过暂存条目数的五分之一（至少 64 条）时才重写基础文件，每次改动的均摊代价为 O(1)
+    constexpr size_t MIN_DELTA = 64;
+    lock_index();
+    if (indexDelta >= std::max(MIN_DELTA, (stageAdd.size() + stageRemove.size()) / 5)) {
+        persist_index();
+        return;
+    }
+    // 一条记录一次写出，并发追加的记录不会交错
+    std::ostringstream record;
+    record.put(op);
+    ser::serialize(fileName, record);
+    ser::serialize(blobId, record);
+    std::ofstream delta(indexDeltaFile, std::ios::binary | std::ios::app);
+    delta << record.str();
+    delta.close();
+    if (!delta) {
+        throw std::invalid_argument("cannot write file");
+    }
+    if (durable::mode() == durable::Mode::Full) {
+        durable::sync_file(indexDeltaFile);
+    }
+    ++indexDelta;
 }
 
 void Repo::recover_commit_set() {
@@ -107,21 +266,234 @@ void Repo::persist_commit_set() {
     ser::serialize_to_safe_file(allCommits, commitSetFile);
 }
 
-void Repo::recover_branch_set() {
-    if (fs::exists(branchSetFile)) {
-        ser::deserialize_from_file(allBranches, branchSetFile);
+void Repo::recover_remote_set() {
+    if (fs::exists(remoteSetFile)) {
+        ser::deserialize_from_file(remotes, remoteSetFile);
     } else {
-        allBranches.clear();
+        remotes.clear();
+    }
+}
+
+void Repo::persist_remote_set() {
+    ser::serialize_to_safe_file(remotes, remoteSetFile);
+}
+
+void Repo::recover_shallow_set() {
+    if (fs::exists(shallowFile)) {
+        ser::deserialize_from_file(shallow, shallowFile);
+    } else {
+        shallow.clear();
+    }
+}
+
+const vector<fs::path>& Repo::alternates(const path& git) {
+    // 每个仓库只读取一次；以绝对路径为键，clone 切换工作目录后也不会混淆
+    static std::map<path, vector<path>> cache;
+    auto key = fs::absolute(git);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        vector<string> dirs;
+        if (fs::exists(git / "ALTERNATES")) {
+            ser::deserialize_from_file(dirs, git / "ALTERNATES");
+        }
+        it = cache.emplace(key, vector<path>(dirs.begin(), dirs.end())).first;
+    }
+    return it->second;
+}
+
+fs::path Repo::find_object(const path& git, string_view id) {
+    auto local = id_to_dir(git, id);
+    const auto& alts = alternates(git);
+    // 没有 alternates 的仓库不多做一次 stat
+    if (alts.empty() || fs::exists(local)) {
+        return local;
+    }
+    for (const auto& alt : alts) {
+        auto borrowed = alt / id.substr(0, 2) / id.substr(2, 38);
+        if (fs::exists(borrowed)) {
+            return borrowed;
+        }
+    }
+    return local;
+}
+
+bloom::Filter& Repo::object_filter(const path& git) {
+    static std::map<path, bloom::Filter> cache;
+    auto key = fs::absolute(git);
+    auto it = cache.find(key);
+    if (it == cache.end()) {
+        it = cache.emplace(key, bloom::Filter(git / "OBJECT_FILTER")).first;
+    }
+    return it->second;
+}
+
+bool Repo::has_object(const path& git, string_view id) {
+    // 过滤器判定可能存在时仍以文件为准；借用的对象目录各自查其所属仓库的过滤器
+    if (object_filter(git).may_contain(id) && fs::exists(id_to_dir(git, id))) {
+        return true;
+    }
+    for (const auto& alt : alternates(git)) {
+        if (object_filter(alt.parent_path()).may_contain(id) && fs::exists(alt / id.substr(0, 2) / id.substr(2, 38))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Repo::record_objects(const path& git, const vector<string>& ids) {
+    // 本进程记入过的 ID：其中尚在事务里的对象还只是临时文件，重建时 list_objects 看不到
+    static std::map<path, vector<string>> recorded;
+    auto& mine = recorded[fs::absolute(git)];
+    mine.insert(mine.end(), ids.begin(), ids.end());
+    auto& filter = object_filter(git);
+    filter.add(ids);
+    if (filter.full()) {
+        auto all = list_objects(git);
+        all.insert(all.end(), mine.begin(), mine.end());
+        std::ranges::sort(all);
+        auto dup = std::ranges::unique(all);
+        all.erase(dup.begin(), dup.end());
+        bloom::Filter::create(git / "OBJECT_FILTER", all);
+        filter = bloom::Filter(git / "OBJECT_FILTER");
+    }
+}
+
+vector<string> Repo::list_objects(const path& git) {
+    vector<string> ids;
+    for (const auto& dir : fs::directory_iterator(git / "objects")) {
+        if (!dir.is_directory()) {
+            continue;
+        }
+        string prefix = dir.path().filename().string();
+        for (const auto& entry : fs::directory_iterator(dir.path())) {
+            string id = prefix + entry.path().filename().string();
+            // 跳过写入中的临时文件
+            if (id.size() == Utils::UID_LENGTH) {
+                ids.push_back(std::move(id));
+            }
+        }
+    }
+    return ids;
+}
+
+fs::path Repo::ensure_object(string_view id) {
+    auto found = find_object(gitDir, id);
+    if (fs::exists(found)) {
+        return found;
+    }
+    auto target = id_to_dir(id);
+    // 只有真正缺失时才去读取 PROMISOR，完整仓库不付出任何代价
+    if (!promisor && fs::exists(promisorFile)) {
+        string source;
+        ser::deserialize_from_file(source, promisorFile);
+        promisor = source;
+    }
+    if (!promisor) {
+        throw GitliteException(format("Object {} is missing.", id));
+    }
+    auto source = find_object(*promisor, id);
+    if (!fs::exists(source)) {
+        // 调用方随即读取或复制返回的路径：缺失时在这里报告，而不是留给文件系统抛出异常
+        throw GitliteException(format("Object {} is missing from promisor {}.", id, promisor->string()));
+    }
+    fs::create_directories(target.parent_path());
+    fs::copy_file(source, target, fs::copy_options::skip_existing);
+    record_objects(gitDir, {string(id)});
+    return target;
+}
+
+const sparse::Cone& Repo::sparse_cone() {
+    if (!cone) {
+        std::set<string> dirs;
+        if (fs::exists(sparseFile)) {
+            ser::deserialize_from_file(dirs, sparseFile);
+        }
+        cone.emplace(dirs);
+    }
+    return *cone;
+}
+
+sparse::Index& Repo::sparse_index() {
+    if (!sindex && fs::exists(sparseIndexFile)) {
+        sindex.emplace();
+        ser::deserialize_from_file(*sindex, sparseIndexFile);
+    }
+    if (sindex && sindex->commit == headCommitId && sindex->patterns == sparse_cone().dirs()) {
+        return *sindex;
+    }
+    // HEAD 移动过（checkout、reset、merge）或稀疏模式变了：由完整提交重建一次
+    Commit head;
+    ser::deserialize_from_file(head, find_object(gitDir, headCommitId));
+    sindex = sparse::Index::build(headCommitId, sparse_cone(), head.mapping, sparseTreeDir);
+    std::set<string> live;
+    for (const auto& [dir, _] : sindex->sizes) {
+        live.insert(sindex->entries.at(dir));
+    }
+    for (const auto& entry : fs::directory_iterator(sparseTreeDir)) {
+        if (!live.contains(entry.path().filename().string())) {
+            fs::remove(entry.path());
+        }
+    }
+    ser::serialize_to_safe_file(*sindex, sparseIndexFile);
+    return *sindex;
+}
+
+void Repo::write_worktree(con_string name, con_string blobId) {
+    if (!sparse_cone().contains(name)) {
+        return;
+    }
+    fs::path target = name;
+    if (target.has_parent_path()) {
+        fs::create_directories(target.parent_path());
+    }
+    fs::copy_file(ensure_object(blobId), target, fs::copy_options::overwrite_existing);
+}
+
+void Repo::remove_worktree(con_string name) {
+    fs::path target = name;
+    if (!target.has_parent_path()) {
+        Utils::restrictedDelete(target);
+        return;
+    }
+    // restrictedDelete 只认得仓库根目录下的文件；子目录中的文件直接删除，再清理删空的目录
+    if (fs::is_regular_file(target)) {
+        fs::remove(target);
+    }
+    for (auto dir = target.parent_path(); !dir.empty(); dir = dir.parent_path()) {
+        std::error_code ec;
+        if (!fs::is_empty(dir, ec) || ec || !fs::remove(dir, ec)) {
+            break;
+        }
     }
 }
 
-void Repo::persist_branch_set() {
-    ser::serialize_to_safe_file(allBranches, branchSetFile);
+void Repo::scan_worktree(const std::function<void(const string& path)>& visit) {
+    const auto& inCone = sparse_cone();
+    untracked::Cache cache(untrackedFile);
+    // 整个位于稀疏范围之外的目录不进入
+    cache.scan([&](const string& dir) { return inCone.outside_prefix(dir + "/") != 0; },
+               [&](const string& path) {
+                   if (inCone.contains(path)) {
+                       visit(path);
+                   }
+               });
+    cache.save();
+}
+
+void Repo::check_untracked(const Commit& src, const Commit& dst) {
+    scan_worktree([&](const string& path) {
+        if (!src.mapping.contains(path) && dst.mapping.contains(path)) {
+            Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
+        }
+    });
 }
 
 optional<string> Repo::get_id_blob_id(con_string fileName) {
+    if (sparse_cone().enabled()) {
+        return sparse_index().find(fileName, sparseTreeDir);
+    }
     Commit comm;
-    ser::deserialize_from_file(comm, id_to_dir(headCommitId));
+    ser::deserialize_from_file(comm, find_object(gitDir, headCommitId));
     auto it = comm.mapping.find(fileName);
     if (it != comm.mapping.end()) {
         return std::make_optional(it->second);
@@ -129,10 +501,24 @@ optional<string> Repo::get_id_blob_id(con_string fileName) {
     return std::nullopt;
 }
 
+optional<string> Repo::resolve_commit(con_string rev) {
+    if (auto id = refs.read(rev)) {
+        return id;
+    }
+    recover_commit_set();
+    auto it = allCommits.lower_bound(rev);
+    if (rev.empty() || it == allCommits.end() || it->compare(0, rev.size(), rev) != 0) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
 void Repo::git_add(con_string fileName) {
     // 获取 headCommitId
     recover_basic_info();
+    lock_index();
     recover_index();
+    durable::Transaction tx;
 
     // 检查文件存在
     if (!fs::exists(fileName)) {
@@ -148,23 +534,28 @@ void Repo::git_add(con_string fileName) {
     string id_in_blob = SHA1::sha1(content);
 
     // 获取当前 commit 中的哈希并比较
-    Commit comm;
-    string id_in_commit;
-    ser::deserialize_from_file(comm, id_to_dir(headCommitId));
-    auto it = comm.mapping.find(fileName);
-    if (it != comm.mapping.end() && it->second == id_in_blob) {
+    auto id_in_commit = get_id_blob_id(fileName);
+    bool unchanged = id_in_commit == id_in_blob;
+    if (unchanged) {
         // 如果版本相同，则不添加
         stageAdd.erase(fileName); // fileName 如果本来就不存在，那么就什么都没做
     } else {
         // 添加
         stageAdd[fileName] = id_in_blob;
-        // 无论存在但版本不同还是不存在，都记录这个新 blob
-        Utils::writeContents(content, id_to_dir(id_in_blob));
+        // 对象库中已有同样内容（其他路径或更早的版本）时不再重写
+        if (!has_object(gitDir, id_in_blob)) {
+            Utils::writeContents(content, id_to_dir(id_in_blob));
+            record_objects(gitDir, {id_in_blob});
+        }
     }
+    tx.commit();
 
-    // 写回文件暂存区
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    // blob 落盘之后才把暂存记录追加到暂存区
+    if (unchanged) {
+        append_index('U', fileName);
+    } else {
+        append_index('A', fileName, id_in_blob);
+    }
 }
 
 void Repo::git_commit(con_string message) {
@@ -172,51 +563,77 @@ void Repo::git_commit(con_string message) {
     if (message.empty()) {
         Utils::exitWithMessage("Please enter a commit message.");
     }
+    lock_index();
     recover_index();
     if (stageAdd.empty() && stageRemove.empty()) {
         Utils::exitWithMessage("No changes added to the commit.");
     }
     recover_basic_info();
-    recover_commit_set();
-
-    Commit old_comm;
-    ser::deserialize_from_file(old_comm, id_to_dir(headCommitId));
+    // 新提交、暂存区与分支一起落盘，分支最后改名
+    durable::Transaction tx;
 
     // 存入新提交
     Commit comm(message, std::chrono::system_clock::now());
-    comm.mapping = std::move(old_comm.mapping);
-    comm.parents.emplace_back(old_comm.id);
-
-    for (auto&& [k, v] : stageAdd) {
-        comm.mapping[k] = std::move(v);
-    }
-    for (const auto& k : stageRemove) {
-        comm.mapping.erase(k);
+    comm.parents.emplace_back(headCommitId);
+    string id;
+    if (sparse_cone().enabled()) {
+        // 稀疏索引：只改动范围内的条目，折叠的目录原样拼回提交；
+        // 暂存了折叠目录中的文件时先展开该目录
+        auto& index = sparse_index();
+        auto touch = [&](const string& k) {
+            if (auto dir = index.collapsed(k)) {
+                index.expand(*dir, sparseTreeDir);
+            }
+        };
+        for (auto&& [k, v] : stageAdd) {
+            touch(k);
+            index.entries[k] = std::move(v);
+        }
+        for (const auto& k : stageRemove) {
+            touch(k);
+            index.entries.erase(k);
+        }
+        id = add_commit(comm, [&](std::ostream& out) { index.write_mapping(out, sparseTreeDir); });
+        index.commit = id;
+        ser::serialize_to_safe_file(index, sparseIndexFile);
+    } else {
+        Commit old_comm;
+        ser::deserialize_from_file(old_comm, find_object(gitDir, headCommitId));
+        comm.mapping = std::move(old_comm.mapping);
+        for (auto&& [k, v] : stageAdd) {
+            comm.mapping[k] = std::move(v);
+        }
+        for (const auto& k : stageRemove) {
+            comm.mapping.erase(k);
+        }
+        id = add_commit(comm);
     }
 
-    auto id = SHA1::sha1(serialize(comm));
-    comm.id = id;
-    ser::serialize_to_file(comm, id_to_dir(id));
-
-    allCommits.insert(id);
-
     // 清空暂存区
     stageAdd.clear();
     stageRemove.clear();
 
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    persist_index();
 
-    // 设置分支位置
-    update_branch(headBranch, id);
+    // 设置分支位置：分支在读取 HEAD 之后被移动过则放弃整个提交
+    update_branch(headBranch, id, headCommitId);
     headCommitId = id;
-    persist_commit_set();
+    tx.commit();
+    record_commit(id, comm.message);
+}
+
+void Repo::record_commit(con_string id, con_string message) {
+    // 只追加新 ID：并发提交各自的追加都会保留
+    ser::append_to_set_file(vector<string>{id}, commitSetFile);
+    index_messages(gitDir, {{id, message}});
 }
 
 void Repo::git_rm(con_string fileName) {
     // 获取 headCommitId
     recover_basic_info();
+    lock_index();
     recover_index();
+    durable::Transaction tx;
 
     bool reason = false;
 
@@ -226,76 +643,262 @@ void Repo::git_rm(con_string fileName) {
     };
 
     // 获取当前 commit 中的哈希并比较
-    Commit comm;
-    string id_in_commit;
-    ser::deserialize_from_file(comm, id_to_dir(headCommitId));
-    auto it = comm.mapping.find(fileName);
-    if (it != comm.mapping.end()) {
+    bool tracked = get_id_blob_id(fileName).has_value();
+    if (tracked) {
         reason = true;
         stageRemove.emplace(fileName);
-        Utils::restrictedDelete(fileName);
+        remove_worktree(fileName);
     }
 
     if (!reason) {
         Utils::exitWithMessage("No reason to remove the file.");
     }
+    tx.commit();
 
     // 写回文件暂存区
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    append_index(tracked ? 'R' : 'U', fileName);
 }
 
-[[nodiscard]] string format_time_point(const std::chrono::system_clock::time_point& tp) {
-    using namespace std::chrono;
-
-    // Gitlet tests expect second precision; strip sub-second digits.
-    zoned_time zt{current_zone(), floor<seconds>(tp)};
-
-    return std::format("Date: {:%a %b %d %H:%M:%S %Y %z}", zt);
+[[nodiscard]] logfmt::CommitFormatter make_formatter(const LogOptions& options) {
+    if (options.oneline) {
+        return logfmt::CommitFormatter::oneline();
+    }
+    if (options.format) {
+        return logfmt::CommitFormatter::parse(*options.format);
+    }
+    return logfmt::CommitFormatter::standard();
 }
 
-inline void print_commit(const Commit& comm) {
-    cout << "===\n";
-    cout << format("commit {}\n", comm.id);
-    if (comm.parents.size() >= 2) {
-        cout << format("Merge: {} {}\n", comm.parents[0].substr(0, 7), comm.parents[1].substr(0, 7));
+void Repo::walk_range(con_string include, con_string exclude, const std::function<bool(const Commit&)>& visit) {
+    constexpr uint8_t UNINTERESTING = 1;
+    constexpr uint8_t QUEUED = 2;
+    std::unordered_map<string, uint8_t> flags;
+    auto older = [](const Commit& a, const Commit& b) {
+        return a.timestamp != b.timestamp ? a.timestamp < b.timestamp : a.id < b.id;
+    };
+    std::priority_queue<Commit, vector<Commit>, decltype(older)> queue(older);
+    size_t interesting = 0; // 队列中仍感兴趣的提交数
+
+    auto push = [&](const string& id, bool uninteresting) {
+        auto [it, inserted] = flags.try_emplace(id, 0);
+        uint8_t f = it->second;
+        if (!inserted && (f & UNINTERESTING || !uninteresting)) {
+            return;
+        }
+        if (!inserted && f & QUEUED) {
+            // 还在队列中：改为不感兴趣，出队时再把标记传给父提交
+            it->second |= UNINTERESTING;
+            --interesting;
+            return;
+        }
+        // 新提交，或已经出队后才发现是 exclude 的祖先：重新入队以传播标记
+        it->second = QUEUED | (uninteresting ? UNINTERESTING : 0);
+        if (!uninteresting) {
+            ++interesting;
+        }
+        Commit comm;
+        deserialize_header_from_file(comm, find_object(gitDir, id));
+        queue.push(std::move(comm));
+    };
+
+    // 先确定范围再输出：时间戳精度只有秒，同一秒内的提交出队顺序不能说明祖先关系。
+    // 队列里已没有感兴趣的提交、且剩下的都早于已收集的最旧提交时，它们不可能再
+    // 到达已收集的提交（父提交不晚于子提交），遍历即可结束。
+    vector<Commit> picked;
+    push(exclude, true);
+    push(include, false);
+    while (!queue.empty() && (interesting > 0 || (!picked.empty() && queue.top().timestamp >= picked.back().timestamp))) {
+        Commit comm = queue.top();
+        queue.pop();
+        uint8_t& f = flags[comm.id];
+        f &= ~QUEUED;
+        bool uninteresting = f & UNINTERESTING;
+        if (!uninteresting) {
+            --interesting;
+            picked.push_back(comm);
+        }
+        if (shallow.contains(comm.id)) {
+            continue;
+        }
+        for (const auto& p : comm.parents) {
+            push(p, uninteresting);
+        }
+    }
+    for (const auto& comm : picked) {
+        if (!(flags[comm.id] & UNINTERESTING) && !visit(comm)) {
+            return;
+        }
     }
-    cout << format_time_point(comm.timestamp) << "\n";
-    cout << comm.message << "\n\n";
 }
-void Repo::git_log() {
+
+void Repo::git_log(const LogOptions& options) {
     recover_basic_info();
+    recover_shallow_set();
+    auto formatter = make_formatter(options);
+    logfmt::OutBuffer out;
+    if (options.limit && *options.limit == 0) {
+        return;
+    }
+
+    // 返回 false 表示数量已够或已早于 --since，遍历到此为止
+    size_t shown = 0;
+    auto show = [&](const Commit& comm) {
+        if (options.since && comm.timestamp < *options.since) {
+            return false;
+        }
+        if (!options.until || comm.timestamp <= *options.until) {
+            formatter.append(out.data(), comm);
+            out.maybe_flush();
+            ++shown;
+        }
+        return !options.limit || shown < *options.limit;
+    };
+    auto resolve = [&](const string& rev) {
+        if (rev.empty() || rev == "HEAD") {
+            return headCommitId;
+        }
+        auto id = resolve_commit(rev);
+        if (!id) {
+            Utils::exitWithMessage("No commit with that id exists.");
+        }
+        return *id;
+    };
+
+    auto dots = options.range ? options.range->find("..") : string::npos;
+    if (dots != string::npos) {
+        // A..B：多父提交按时间戳排序遍历
+        string exclude = resolve(options.range->substr(0, dots));
+        string include = resolve(options.range->substr(dots + 2));
+        walk_range(include, exclude, show);
+        return;
+    }
+
+    // 沿第一父提交回溯
     Commit comm;
-    ser::deserialize_from_file(comm, id_to_dir(headCommitId));
+    deserialize_header_from_file(comm, find_object(gitDir, options.range ? resolve(*options.range) : headCommitId));
+    while (show(comm) && !comm.parents.empty() && !shallow.contains(comm.id)) {
+        deserialize_header_from_file(comm, find_object(gitDir, comm.parents[0]));
+    }
+}
 
-    while (true) {
-        print_commit(comm);
-        if (comm.parents.empty())
-            break;
-        ser::deserialize_from_file(comm, id_to_dir(comm.parents[0]));
+vector<fs::path> Repo::commit_files(const std::set<string>& ids) {
+    vector<fs::path> files;
+    files.reserve(ids.size());
+    for (const auto& id : ids) {
+        files.push_back(find_object(gitDir, id));
     }
+    return files;
 }
 
-void Repo::global_log() {
+void Repo::global_log(const LogOptions& options) {
     recover_commit_set();
-    Commit comm;
-    for (const auto& id : allCommits) {
-        ser::deserialize_from_file(comm, id_to_dir(id));
-        print_commit(comm);
+    auto formatter = make_formatter(options);
+    logfmt::OutBuffer out;
+    if (options.limit && *options.limit == 0) {
+        return;
+    }
+    // 没有时间条件时只需读取前 N 个提交
+    auto files = commit_files(allCommits);
+    if (options.limit && !options.since && !options.until && *options.limit < files.size()) {
+        files.resize(*options.limit);
+    }
+    size_t shown = 0;
+    scan::for_each_commit(
+        files,
+        scan::default_jobs(),
+        [&](Commit& comm) {
+            string text;
+            if ((!options.since || comm.timestamp >= *options.since) &&
+                (!options.until || comm.timestamp <= *options.until)) {
+                formatter.append(text, comm);
+            }
+            return text;
+        },
+        [&](size_t, string& text) {
+            if (text.empty()) {
+                return true;
+            }
+            out.data().append(text);
+            out.maybe_flush();
+            return !options.limit || ++shown < *options.limit;
+        },
+        scan::Decode::Header);
+}
+
+void Repo::index_messages(const path& git, const vector<std::pair<string, string>>& entries) {
+    MessageIndex index(git);
+    if (index.exists()) {
+        index.add(entries);
     }
 }
 
-void Repo::find(con_string message) {
+void Repo::rebuild_message_index() {
     recover_commit_set();
-    Commit comm;
-    bool non_empty = false;
-    for (const auto& id : allCommits) {
-        ser::deserialize_from_file(comm, id_to_dir(id));
-        if (comm.message == message) {
-            non_empty = true;
-            cout << comm.id << '\n';
-        }
+    vector<std::pair<string, string>> entries;
+    entries.reserve(allCommits.size());
+    auto it = allCommits.begin();
+    scan::for_each_commit(
+        commit_files(allCommits),
+        scan::default_jobs(),
+        [](Commit& comm) { return std::move(comm.message); },
+        [&](size_t, string& message) {
+            entries.emplace_back(*it++, std::move(message));
+            return true;
+        },
+        scan::Decode::Header);
+    MessageIndex index(gitDir);
+    index.create();
+    index.add(entries);
+}
+
+void Repo::find(con_string message) {
+    MessageIndex index(gitDir);
+    if (!index.exists()) {
+        rebuild_message_index();
+    }
+    auto ids = index.exact(message);
+    if (ids.empty()) {
+        Utils::exitWithMessage("Found no commit with that message.");
+    }
+    for (const auto& id : ids) {
+        cout << id << '\n';
+    }
+}
+
+void Repo::find_grep(con_string pattern) {
+    std::regex re;
+    try {
+        re = std::regex(pattern);
+    } catch (const std::regex_error&) {
+        Utils::exitWithMessage("Invalid pattern.");
+    }
+    MessageIndex index(gitDir);
+    if (!index.exists()) {
+        rebuild_message_index();
+    }
+    // 三元组索引只给出候选，逐个用正则确认；提取不出字面量时扫描全部提交
+    auto candidates = index.candidates(pattern);
+    std::set<string> ids;
+    if (candidates) {
+        ids.insert(candidates->begin(), candidates->end());
+    } else {
+        recover_commit_set();
+        ids = std::move(allCommits);
     }
+    // std::regex 的匹配是只读的，可在各工作线程间共享
+    bool non_empty = false;
+    scan::for_each_commit(
+        commit_files(ids),
+        scan::default_jobs(),
+        [&](Commit& comm) { return std::regex_search(comm.message, re) ? comm.id : string(); },
+        [&](size_t, string& id) {
+            if (!id.empty()) {
+                non_empty = true;
+                cout << id << '\n';
+            }
+            return true;
+        },
+        scan::Decode::Header);
     if (!non_empty) {
         Utils::exitWithMessage("Found no commit with that message.");
     }
@@ -304,10 +907,10 @@ void Repo::find(con_string message) {
 void Repo::checkout_file(con_string fileName) {
     recover_basic_info();
     Commit comm;
-    ser::deserialize_from_file(comm, id_to_dir(headCommitId));
+    ser::deserialize_from_file(comm, find_object(gitDir, headCommitId));
     auto it = comm.mapping.find(fileName);
     if (it != comm.mapping.end()) {
-        fs::copy_file(id_to_dir(it->second), fileName, fs::copy_options::overwrite_existing);
+        fs::copy_file(ensure_object(it->second), fileName, fs::copy_options::overwrite_existing);
     } else {
         Utils::exitWithMessage("File does not exist in that commit.");
     }
@@ -321,10 +924,10 @@ void Repo::checkout_file_in_commit(con_string commitId, con_string fileName) {
     }
 
     Commit comm;
-    ser::deserialize_from_file(comm, id_to_dir(*it));
+    ser::deserialize_from_file(comm, find_object(gitDir, *it));
     auto it2 = comm.mapping.find(fileName);
     if (it2 != comm.mapping.end()) {
-        fs::copy_file(id_to_dir(it2->second), fileName, fs::copy_options::overwrite_existing);
+        fs::copy_file(ensure_object(it2->second), fileName, fs::copy_options::overwrite_existing);
     } else {
         Utils::exitWithMessage("File does not exist in that commit.");
     }
@@ -332,42 +935,36 @@ void Repo::checkout_file_in_commit(con_string commitId, con_string fileName) {
 
 void Repo::checkout_branch(con_string branch) {
     recover_basic_info();
+    lock_index(); // 结束时清空暂存区
     // 该分支是当前分支
     if (branch == headBranch) {
         Utils::exitWithMessage("No need to checkout the current branch.");
     }
 
-    recover_branch_set();
     // 不存在同名分支
-    if (!allBranches.contains(branch)) {
+    auto target = refs.read(branch);
+    if (!target) {
         Utils::exitWithMessage("No such branch exists.");
     }
 
-    const fs::path p = ".";
     Commit src;
-    ser::deserialize_from_file(src, id_to_dir(headCommitId));
+    ser::deserialize_from_file(src, find_object(gitDir, headCommitId));
     Commit dst;
-    string id;
-    ser::deserialize_from_file(id, branchDir / branch);
-    ser::deserialize_from_file(dst, id_to_dir(id));
+    string id = *target;
+    ser::deserialize_from_file(dst, find_object(gitDir, id));
 
-    for (const auto& entry : fs::directory_iterator(p)) {
-        auto name = entry.path().filename().string();
-        if (!src.mapping.contains(name) && dst.mapping.contains(name)) {
-            Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
-        }
-    }
+    check_untracked(src, dst);
 
     // 删除当前提交有但目标提交没有的跟踪文件
     for (const auto& [name, _] : src.mapping) {
         if (!dst.mapping.contains(name)) {
-            Utils::restrictedDelete(p / name);
+            remove_worktree(name);
         }
     }
 
-    // 将目标提交中的文件写入工作区
+    // 将目标提交中的文件写入工作区（稀疏范围之外的跳过）
     for (const auto& [name, blobId] : dst.mapping) {
-        fs::copy_file(id_to_dir(blobId), p / name, fs::copy_options::overwrite_existing);
+        write_worktree(name, blobId);
     }
 
     // 切换分支并清空暂存区
@@ -375,20 +972,18 @@ void Repo::checkout_branch(con_string branch) {
     headCommitId = id;
     stageAdd.clear();
     stageRemove.clear();
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    persist_index();
 
     update_head(branch);
 }
 
 void Repo::status() {
     recover_basic_info();
-    recover_branch_set();
     recover_index();
 
     cout << "=== Branches ===\n";
     cout << format("*{}\n", headBranch);
-    for (const auto& i : allBranches) {
+    for (const auto& [i, _] : refs.list()) {
         if (i != headBranch) {
             cout << i << '\n';
         }
@@ -401,90 +996,285 @@ void Repo::status() {
     for (const auto& i : stageRemove) {
         cout << i << '\n';
     }
-    cout << "\n=== Modifications Not Staged For Commit ===\n";
-    cout << "\n=== Untracked Files ===\n";
-}
 
-void Repo::branch(con_string name) {
-    recover_basic_info();
-    recover_branch_set();
-    if (allBranches.contains(name)) {
-        Utils::exitWithMessage("A branch with that name already exists.");
+    // 已跟踪文件的改动需要比较内容：大小与修改时间和上次计算哈希时相同的文件直接沿用缓存的结果；
+    // 稀疏范围之外的文件不在工作区中，不算删除
+    Commit head;
+    ser::deserialize_from_file(head, find_object(gitDir, headCommitId));
+    const auto& inCone = sparse_cone();
+    std::map<string, string_view> modified;
+    worktree::StatCache stats(statFile);
+    auto compare = [&](const string& name, const string& blobId) {
+        auto current = stats.blob_id(name);
+        if (!current) {
+            modified.emplace(name, "deleted");
+        } else if (*current != blobId) {
+            modified.emplace(name, "modified");
+        }
+    };
+    for (const auto& [name, blobId] : head.mapping) {
+        if (inCone.contains(name) && !stageAdd.contains(name) && !stageRemove.contains(name)) {
+            compare(name, blobId);
+        }
     }
-    string id = headCommitId;
-    update_branch(name, id);
-    allBranches.emplace(name);
-    persist_branch_set();
-}
-
-void Repo::rm_branch(con_string name) {
-    recover_basic_info();
-    if (headBranch == name) {
-        Utils::exitWithMessage("Cannot remove the current branch.");
+    for (const auto& [name, blobId] : stageAdd) {
+        compare(name, blobId);
     }
-
-    recover_branch_set();
-    if (!allBranches.contains(name)) {
-        Utils::exitWithMessage("A branch with that name does not exist.");
+    stats.save();
+    cout << "\n=== Modifications Not Staged For Commit ===\n";
+    for (const auto& [name, kind] : modified) {
+        cout << format("{} ({})\n", name, kind);
     }
 
-    // 删除分支引用文件（不使用 restrictedDelete，避免路径检查失效）
-    fs::remove(branchDir / name);
-    allBranches.erase(name);
-    persist_branch_set();
-}
-
-void Repo::reset(con_string commitId) {
-    recover_commit_set();
-    if (!allCommits.contains(commitId)) {
-        Utils::exitWithMessage("No commit with that id exists.");
+    // 暂存删除后又重新出现的文件同样算未跟踪
+    std::set<string> untracked;
+    scan_worktree([&](const string& path) {
+        if (!stageAdd.contains(path) && (!head.mapping.contains(path) || stageRemove.contains(path))) {
+            untracked.insert(path);
+        }
+    });
+    cout << "\n=== Untracked Files ===\n";
+    for (const auto& name : untracked) {
+        cout << name << '\n';
     }
-    recover_basic_info();
+}
 
-    const fs::path p = ".";
-    Commit src;
-    ser::deserialize_from_file(src, id_to_dir(headCommitId));
-    Commit dst;
-    ser::deserialize_from_file(dst, id_to_dir(commitId));
+void Repo::diff_mappings(const std::map<string, string>& from,
+                         const std::map<string, string>& to,
+                         const content_loader& loadFrom,
+                         const content_loader& loadTo,
+                         string& out) {
+    auto emit = [&](const string& name, const string* idA, const string* idB) {
+        string a = idA != nullptr ? loadFrom(name, *idA) : string();
+        string b = idB != nullptr ? loadTo(name, *idB) : string();
+        string body;
+        diff::unified(body,
+                      idA != nullptr ? "a/" + name : "/dev/null",
+                      idB != nullptr ? "b/" + name : "/dev/null",
+                      a,
+                      b);
+        if (body.empty() && idA != nullptr && idB != nullptr) {
+            return;
+        }
+        out.append(format("diff --git a/{} b/{}\n", name, name));
+        if (idA == nullptr) {
+            out.append("new file\n");
+        } else if (idB == nullptr) {
+            out.append("deleted file\n");
+        }
+        out.append(body);
+    };
 
-    for (const auto& entry : fs::directory_iterator(p)) {
-        auto name = entry.path().filename().string();
-        if (!src.mapping.contains(name) && dst.mapping.contains(name)) {
-            Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
+    // 先找出只在一侧出现的路径，配对重命名后再按路径顺序输出
+    std::map<string, string> deleted;
+    std::map<string, string> added;
+    for (const auto& [name, id] : from) {
+        if (!to.contains(name)) {
+            deleted.emplace(name, id);
         }
     }
-
-    // 删除当前提交有但目标提交没有的跟踪文件
-    for (const auto& [name, _] : src.mapping) {
-        if (!dst.mapping.contains(name)) {
-            Utils::restrictedDelete(p / name);
+    for (const auto& [name, id] : to) {
+        if (!from.contains(name)) {
+            added.emplace(name, id);
         }
     }
-
-    // 将目标提交中的文件写入工作区
-    for (const auto& [name, blobId] : dst.mapping) {
-        fs::copy_file(id_to_dir(blobId), p / name, fs::copy_options::overwrite_existing);
+    std::unordered_map<string, diff::RenamePair> renamedTo;
+    std::unordered_set<string> renamedFrom;
+    if (!deleted.empty() && !added.empty()) {
+        for (auto& pair : diff::detect_renames(deleted, added, loadFrom, loadTo)) {
+            renamedFrom.insert(pair.from);
+            renamedTo.emplace(pair.to, std::move(pair));
+        }
     }
+    auto emit_rename = [&](const diff::RenamePair& pair) {
+        string a = loadFrom(pair.from, from.at(pair.from));
+        string b = loadTo(pair.to, to.at(pair.to));
+        out.append(format("diff --git a/{} b/{}\n", pair.from, pair.to));
+        out.append(format("similarity index {}%\n", pair.score));
+        out.append(format("rename from {}\nrename to {}\n", pair.from, pair.to));
+        diff::unified(out, "a/" + pair.from, "b/" + pair.to, a, b);
+    };
 
-    // 切换分支并清空暂存区
-    stageAdd.clear();
+    auto itA = from.begin();
+    auto itB = to.begin();
+    while (itA != from.end() || itB != to.end()) {
+        int cmp = itA == from.end() ? 1 : itB == to.end() ? -1 : itA->first.compare(itB->first);
+        if (cmp == 0) {
+            if (itA->second != itB->second) {
+                emit(itA->first, &itA->second, &itB->second);
+            }
+            ++itA;
+            ++itB;
+        } else if (cmp < 0) {
+            if (!renamedFrom.contains(itA->first)) {
+                emit(itA->first, &itA->second, nullptr);
+            }
+            ++itA;
+        } else {
+            auto it = renamedTo.find(itB->first);
+            if (it != renamedTo.end()) {
+                emit_rename(it->second);
+            } else {
+                emit(itB->first, nullptr, &itB->second);
+            }
+            ++itB;
+        }
+    }
+}
+
+void Repo::diff(const vector<string>& revs, bool cached) {
+    content_loader loadBlob = [this](const string&, const string& id) {
+        string content;
+        Utils::readContentsAsString(content, ensure_object(id));
+        return content;
+    };
+    string out;
+
+    if (revs.size() == 2) {
+        Commit A;
+        Commit B;
+        auto idA = resolve_commit(revs[0]);
+        auto idB = resolve_commit(revs[1]);
+        if (!idA || !idB) {
+            Utils::exitWithMessage("No commit with that id exists.");
+        }
+        ser::deserialize_from_file(A, find_object(gitDir, *idA));
+        ser::deserialize_from_file(B, find_object(gitDir, *idB));
+        diff_mappings(A.mapping, B.mapping, loadBlob, loadBlob, out);
+        cout << out;
+        return;
+    }
+
+    recover_basic_info();
+    recover_index();
+    Commit head;
+    ser::deserialize_from_file(head, find_object(gitDir, headCommitId));
+    auto index = head.mapping;
+    for (const auto& [k, v] : stageAdd) {
+        index[k] = v;
+    }
+    for (const auto& k : stageRemove) {
+        index.erase(k);
+    }
+
+    if (cached) {
+        diff_mappings(head.mapping, index, loadBlob, loadBlob, out);
+        cout << out;
+        return;
+    }
+
+    // 稀疏范围之外的文件不在工作区中，与 status 一样不算删除（暂存过的除外）
+    const auto& inCone = sparse_cone();
+    std::erase_if(index, [&](const auto& entry) {
+        return !inCone.contains(entry.first) && !stageAdd.contains(entry.first);
+    });
+
+    // 工作区与暂存区：与 status 共用 stat 缓存，未改动的文件不读取；只为内容确实不同的文件保留内容
+    std::map<string, string> work;
+    std::unordered_map<string, string> changed;
+    worktree::StatCache stats(statFile);
+    for (const auto& [name, id] : index) {
+        auto workId = stats.blob_id(name);
+        if (!workId) {
+            continue;
+        }
+        if (*workId != id) {
+            Utils::readContentsAsString(changed[name], name);
+        }
+        work.emplace(name, std::move(*workId));
+    }
+    stats.save();
+    content_loader loadWork = [&](const string& name, const string&) { return changed.at(name); };
+    diff_mappings(index, work, loadBlob, loadWork, out);
+    cout << out;
+}
+
+void Repo::branch(con_string name) {
+    recover_basic_info();
+    // 新建分支只写一个松散引用；是否重名由 update_ref 在锁内判断
+    if (!update_ref(gitDir, name, headCommitId, "")) {
+        Utils::exitWithMessage("A branch with that name already exists.");
+    }
+}
+
+void Repo::rm_branch(con_string name) {
+    recover_basic_info();
+    if (headBranch == name) {
+        Utils::exitWithMessage("Cannot remove the current branch.");
+    }
+
+    if (!refs.exists(name)) {
+        Utils::exitWithMessage("A branch with that name does not exist.");
+    }
+
+    // 删除分支引用（不使用 restrictedDelete，避免路径检查失效）
+    refs.remove(name);
+}
+
+void Repo::reset(con_string commitId) {
+    recover_commit_set();
+    if (!allCommits.contains(commitId)) {
+        Utils::exitWithMessage("No commit with that id exists.");
+    }
+    recover_basic_info();
+    lock_index(); // 结束时清空暂存区
+
+    Commit src;
+    ser::deserialize_from_file(src, find_object(gitDir, headCommitId));
+    Commit dst;
+    ser::deserialize_from_file(dst, find_object(gitDir, commitId));
+
+    check_untracked(src, dst);
+
+    // 删除当前提交有但目标提交没有的跟踪文件
+    for (const auto& [name, _] : src.mapping) {
+        if (!dst.mapping.contains(name)) {
+            remove_worktree(name);
+        }
+    }
+
+    // 将目标提交中的文件写入工作区（稀疏范围之外的跳过）
+    for (const auto& [name, blobId] : dst.mapping) {
+        write_worktree(name, blobId);
+    }
+
+    // 切换分支并清空暂存区
+    stageAdd.clear();
     stageRemove.clear();
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    persist_index();
+
+    update_branch(headBranch, commitId, headCommitId);
+}
 
-    update_branch(headBranch, commitId);
+// 合并结果只构建一次：一次哈希，写入对象库与工作区
+string Repo::store_merged(con_string fileName, const string& content, bool write) {
+    SHA1::Context ctx;
+    ctx.update(content);
+    string blobId = ctx.digest();
+    if (!has_object(gitDir, blobId)) {
+        Utils::writeContents(content, id_to_dir(blobId));
+        record_objects(gitDir, {blobId});
+    }
+    if (write) {
+        if (fs::path(fileName).has_parent_path()) {
+            fs::create_directories(fs::path(fileName).parent_path());
+        }
+        Utils::writeContents_safe(content, fileName);
+    }
+    return blobId;
 }
 
-[[nodiscard]] Commit Repo::merge_base(Commit A, Commit B) {
+Commit Repo::merge_base(Commit A, Commit B) {
     std::queue<Commit> q1;
     std::queue<Commit> q2;
     q1.push(std::move(A));
     q2.push(std::move(B));
 
     std::unordered_map<string, int> color;
+    // 浅克隆中可能找不到公共祖先：两侧都走到边界后以空提交作为分割点
     Commit ans;
     bool flag = true;
-    while (flag) {
+    while (flag && (!q1.empty() || !q2.empty())) {
         size_t s1 = q1.size();
         for (int i = 0; i < s1 && flag; ++i) {
             auto f = q1.front();
@@ -496,9 +1286,11 @@ void Repo::reset(con_string commitId) {
                 break;
             };
             color[f.id] = 1;
+            if (shallow.contains(f.id))
+                continue;
             for (const auto& p : f.parents) {
                 Commit parent;
-                ser::deserialize_from_file(parent, id_to_dir(p));
+                deserialize_header_from_file(parent, find_object(gitDir, p));
                 q1.push(std::move(parent));
             }
         }
@@ -513,36 +1305,54 @@ void Repo::reset(con_string commitId) {
                 break;
             };
             color[f.id] = 2;
+            if (shallow.contains(f.id))
+                continue;
             for (const auto& p : f.parents) {
                 Commit parent;
-                ser::deserialize_from_file(parent, id_to_dir(p));
+                deserialize_header_from_file(parent, find_object(gitDir, p));
                 q2.push(std::move(parent));
             }
         }
     }
+    // 搜索只用到父提交；找到分割点后再读取它的文件映射
+    if (!ans.id.empty()) {
+        ser::deserialize_from_file(ans, find_object(gitDir, ans.id));
+    }
     return ans;
 }
 
 void Repo::merge(con_string branch) {
-    if (!fs::exists(branchDir / branch)) {
+    auto other = refs.read(branch);
+    if (!other) {
         Utils::exitWithMessage("A branch with that name does not exist.");
     }
     recover_basic_info();
     if (branch == headBranch) {
         Utils::exitWithMessage("Cannot merge a branch with itself.");
     }
+    lock_index();
     recover_index();
     if (!stageAdd.empty() || !stageRemove.empty()) {
         Utils::exitWithMessage("You have uncommitted changes.");
     }
     string commit_a = headCommitId;
-    string commit_b;
-    ser::deserialize_from_file(commit_b, branchDir / branch);
+    string commit_b = *other;
     Commit A;
     Commit B;
-    ser::deserialize_from_file(A, id_to_dir(commit_a));
-    ser::deserialize_from_file(B, id_to_dir(commit_b));
-
+    ser::deserialize_from_file(A, find_object(gitDir, commit_a));
+    ser::deserialize_from_file(B, find_object(gitDir, commit_b));
+
+    recover_shallow_set();
+    // 有位图时先判断祖先关系，快进和“已是祖先”两种情况无需求公共祖先
+    if (fs::exists(gitDir / "bitmaps")) {
+        if (in_history(commit_b, commit_a)) {
+            reset(commit_b);
+            Utils::exitWithMessage("Current branch fast-forwarded.");
+        }
+        if (in_history(commit_a, commit_b)) {
+            Utils::exitWithMessage("Given branch is an ancestor of the current branch.");
+        }
+    }
     Commit base = merge_base(A, B);
     string base_id = base.id;
     if (base_id == commit_a) {
@@ -557,7 +1367,77 @@ void Repo::merge(con_string branch) {
     auto& map_b = B.mapping;
     auto& map_c = base.mapping;
     bool conflict = false;
+    // 稀疏范围之外的路径不检查未跟踪文件、不写工作区；冲突文件例外，照常写出供用户解决
+    const auto& inCone = sparse_cone();
+
+    // 改动工作区之前一次检查完。会覆盖当前提交未跟踪文件的只有当前提交没有的路径：
+    // 给定分支新增的（含改名的新路径），以及当前分支删除、给定分支又改动的（写出冲突文件）
+    for (const auto& [k, blobB] : map_b) {
+        if (map_a.contains(k) || !inCone.contains(k)) {
+            continue;
+        }
+        auto itC = map_c.find(k);
+        if ((itC == map_c.end() || itC->second != blobB) && fs::exists(k)) {
+            Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
+        }
+    }
+
+    // 重命名检测：一侧把文件改名、另一侧修改了原文件时，把两侧改动合并到新路径上。
+    // 只有被对方修改过的消失路径才是候选来源，通常无需读取任何内容。
+    diff::blob_loader loadBlob = [this](const string&, const string& id) {
+        string content;
+        Utils::readContentsAsString(content, ensure_object(id));
+        return content;
+    };
+    auto side_renames = [&](const std::map<string, string>& side, const std::map<string, string>& other) {
+        std::map<string, string> deleted;
+        std::map<string, string> added;
+        for (const auto& [k, vbase] : map_c) {
+            auto it = other.find(k);
+            if (!side.contains(k) && it != other.end() && it->second != vbase) {
+                deleted.emplace(k, vbase);
+            }
+        }
+        if (!deleted.empty()) {
+            for (const auto& [k, v] : side) {
+                if (!map_c.contains(k) && !other.contains(k)) {
+                    added.emplace(k, v);
+                }
+            }
+        }
+        return added.empty() ? vector<diff::RenamePair>{} : diff::detect_renames(deleted, added, loadBlob, loadBlob);
+    };
+    std::unordered_set<string> renamed;
+    auto merge_rename = [&](const string& baseId, const string& idA, const string& idB, const string& target) {
+        string contentBase;
+        string contentA;
+        string contentB;
+        Utils::readContentsAsString(contentBase, ensure_object(baseId));
+        Utils::readContentsAsString(contentA, ensure_object(idA));
+        Utils::readContentsAsString(contentB, ensure_object(idB));
+        string merged;
+        bool clean = diff::merge3(contentBase, contentA, contentB, merged);
+        conflict = conflict || !clean;
+        stageAdd[target] = store_merged(target, merged, !clean || inCone.contains(target));
+    };
+    // 当前分支改名、给定分支修改：新路径已在工作区中，原路径保持删除
+    for (const auto& pair : side_renames(map_a, map_b)) {
+        merge_rename(map_c.at(pair.from), map_a.at(pair.to), map_b.at(pair.from), pair.to);
+        renamed.insert(pair.from);
+    }
+    // 给定分支改名、当前分支修改：写出新路径并删除原路径
+    for (const auto& pair : side_renames(map_b, map_a)) {
+        merge_rename(map_c.at(pair.from), map_a.at(pair.from), map_b.at(pair.to), pair.to);
+        remove_worktree(pair.from);
+        stageRemove.insert(pair.from);
+        renamed.insert(pair.from);
+        renamed.insert(pair.to);
+    }
+
     for (const auto& [k, vbase] : map_c) {
+        if (renamed.contains(k)) {
+            continue;
+        }
         auto itA = map_a.find(k);
         auto itB = map_b.find(k);
         bool deletedA = itA == map_a.end();
@@ -566,18 +1446,14 @@ void Repo::merge(con_string branch) {
         bool changedB = deletedB || itB->second != vbase;
         // 1+6. 在给定分支中变动，本地没变动，听对方的！
         if (changedB && !changedA) {
-            // 未跟踪覆盖检查
-            if (fs::exists(k) && !map_a.contains(k)) {
-                Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
-            }
             // 6. 给定分支删除
             if (deletedB) {
-                Utils::restrictedDelete(k);
+                remove_worktree(k);
                 stageRemove.insert(k);
             }
             // 1. 给定分支修改（非删除）
             else {
-                fs::copy_file(id_to_dir(itB->second), k, fs::copy_options::overwrite_existing);
+                write_worktree(k, itB->second);
                 stageAdd[k] = itB->second;
             }
         }
@@ -588,55 +1464,38 @@ void Repo::merge(con_string branch) {
         }
         // 情况 8 的一种: 变动方式不同
         else if (changedA && changedB) {
-            // 未跟踪覆盖检查
-            if (!map_a.contains(k) && fs::exists(k) && !stageAdd.contains(k) && !stageRemove.contains(k)) {
-                Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
-            }
-            conflict = true;
-            string all = "<<<<<<< HEAD\n";
+            string contentA;
+            string contentB;
             if (!deletedA) {
-                string contentA;
-                Utils::readContentsAsString(contentA, id_to_dir(itA->second));
-                while (!contentA.empty() && (contentA.back() == '\n' || contentA.back() == '\r')) {
-                    contentA.pop_back();
-                }
-                all.append(contentA);
+                Utils::readContentsAsString(contentA, ensure_object(itA->second));
             }
-            all.append("\n=======\n");
             if (!deletedB) {
-                string contentB;
-                Utils::readContentsAsString(contentB, id_to_dir(itB->second));
-                while (!contentB.empty() && (contentB.back() == '\n' || contentB.back() == '\r')) {
-                    contentB.pop_back();
-                }
-                all.append(contentB);
+                Utils::readContentsAsString(contentB, ensure_object(itB->second));
             }
-            if (!deletedB) {
-                all.append("\n>>>>>>>\n");
+            string merged;
+            bool clean = false;
+            if (deletedA || deletedB) {
+                // 一侧删除、另一侧修改：整个文件冲突
+                diff::append_conflict(merged, contentA, contentB);
             } else {
-                all.append(">>>>>>>\n");
+                // 两侧都修改：以分割点版本为基础逐行三方合并，只有重叠的改动才产生冲突
+                string contentBase;
+                Utils::readContentsAsString(contentBase, ensure_object(vbase));
+                clean = diff::merge3(contentBase, contentA, contentB, merged);
             }
-            Utils::writeContents_safe(all, k);
-            string blobId = SHA1::sha1(all);
-            Utils::writeContents(all, id_to_dir(blobId));
-            stageAdd[k] = blobId;
+            conflict = conflict || !clean;
+            stageAdd[k] = store_merged(k, merged, !clean || inCone.contains(k));
             stageRemove.erase(k);
         }
     }
 
     // 情况 5
     for (const auto& [k, blobB] : map_b) {
-        if (map_c.contains(k) || map_a.contains(k))
+        if (map_c.contains(k) || map_a.contains(k) || renamed.contains(k))
             continue;
 
-        // 未跟踪覆盖检查
-        fs::path path = k;
-        if (fs::exists(path) && !stageAdd.contains(k) && !stageRemove.contains(k) && !map_a.contains(k)) {
-            Utils::exitWithMessage("There is an untracked file in the way; delete it, or add and commit it first.");
-        }
-
         // 取目标版本并暂存
-        fs::copy_file(id_to_dir(blobB), path, fs::copy_options::overwrite_existing);
+        write_worktree(k, blobB);
         stageAdd[k] = blobB;
     }
 
@@ -647,35 +1506,19 @@ void Repo::merge(con_string branch) {
         if (blobA == map_b.find(k)->second)
             continue;
         conflict = true;
-        string all = "<<<<<<< HEAD\n";
         string contentA;
-        Utils::readContentsAsString(contentA, id_to_dir(blobA));
-        while (!contentA.empty() && (contentA.back() == '\n' || contentA.back() == '\r')) {
-            contentA.pop_back();
-        }
-        all.append(contentA);
-        all.append("\n=======\n");
         string contentB;
-        Utils::readContentsAsString(contentB, id_to_dir(map_b.find(k)->second));
-        while (!contentB.empty() && (contentB.back() == '\n' || contentB.back() == '\r')) {
-            contentB.pop_back();
-        }
-        all.append(contentB);
-        if (!contentB.empty()) {
-            all.append("\n>>>>>>>\n");
-        } else {
-            all.append(">>>>>>>\n");
-        }
-        Utils::writeContents_safe(all, k);
-        string blobId = SHA1::sha1(all);
-        Utils::writeContents(all, id_to_dir(blobId));
-        stageAdd[k] = blobId;
+        Utils::readContentsAsString(contentA, ensure_object(blobA));
+        Utils::readContentsAsString(contentB, ensure_object(map_b.find(k)->second));
+        string merged;
+        diff::append_conflict(merged, contentA, contentB);
+        stageAdd[k] = store_merged(k, merged);
         stageRemove.erase(k);
     }
 
     // 写回暂存区
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    durable::Transaction tx;
+    persist_index();
 
     Commit comm(format("Merged {} into {}.", branch, headBranch), std::chrono::system_clock::now());
     comm.parents.emplace_back(A.id);
@@ -688,24 +1531,891 @@ void Repo::merge(con_string branch) {
         comm.mapping.erase(k);
     }
 
-    auto id = SHA1::sha1(serialize(comm));
-    comm.id = id;
-    ser::serialize_to_file(comm, id_to_dir(id));
-
-    allCommits.insert(id);
+    auto id = add_commit(comm);
 
     // 清空暂存区
     stageAdd.clear();
     stageRemove.clear();
-    ser::serialize_to_safe_file(stageAdd, gitDir / "INDEX1");
-    ser::serialize_to_safe_file(stageRemove, gitDir / "INDEX2");
+    persist_index();
 
     // 设置分支位置
-    update_branch(headBranch, id);
+    update_branch(headBranch, id, commit_a);
     headCommitId = id;
-    persist_commit_set();
+    tx.commit();
+    // 提交集合没有载入过，不能用 persist_commit_set 整体改写
+    record_commit(id, comm.message);
 
     if (conflict) {
         Utils::message("Encountered a merge conflict.");
     }
 }
+
+void Repo::add_remote(con_string name, con_string remotePath) {
+    bool added = false;
+    ser::update_file<std::map<string, string>>(remoteSetFile, [&](std::map<string, string>& all) {
+        added = all.emplace(name, fs::path(remotePath).make_preferred().string()).second;
+    });
+    if (!added) {
+        Utils::exitWithMessage("A remote with that name already exists.");
+    }
+}
+
+void Repo::rm_remote(con_string name) {
+    bool removed = false;
+    ser::update_file<std::map<string, string>>(
+        remoteSetFile, [&](std::map<string, string>& all) { removed = all.erase(name) != 0; });
+    if (!removed) {
+        Utils::exitWithMessage("A remote with that name does not exist.");
+    }
+}
+
+fs::path Repo::remote_git_dir(con_string name) {
+    recover_remote_set();
+    auto it = remotes.find(name);
+    if (it == remotes.end()) {
+        Utils::exitWithMessage("A remote with that name does not exist.");
+    }
+    fs::path git = it->second;
+    if (!fs::is_directory(git)) {
+        Utils::exitWithMessage("Remote directory not found.");
+    }
+    return git;
+}
+
+fs::path Repo::bitmap_file(string_view id) {
+    return gitDir / "bitmaps" / id.substr(0, 2) / id.substr(2, 38);
+}
+
+bool Repo::reach_into(bitmap::Bitmap& bm,
+                      bitmap::ObjectTable& table,
+                      const vector<string>& starts,
+                      bool withBlobs,
+                      std::optional<size_t> stop) {
+    auto reached = [&] { return stop && bm.test(*stop); };
+    vector<string> stack(starts.rbegin(), starts.rend());
+    Commit comm;
+    string data;
+    while (!stack.empty()) {
+        string id = std::move(stack.back());
+        stack.pop_back();
+        size_t pos = table.assign(id);
+        if (bm.test(pos)) {
+            continue;
+        }
+        auto stored = bitmap_file(id);
+        if (fs::exists(stored)) {
+            Utils::readContentsAsString(data, stored);
+            bm |= bitmap::Bitmap::decode(data);
+            if (reached()) {
+                return true;
+            }
+            continue;
+        }
+        bm.set(pos);
+        if (reached()) {
+            return true;
+        }
+        if (withBlobs) {
+            ser::deserialize_from_file(comm, find_object(gitDir, id));
+            for (const auto& [_, blob] : comm.mapping) {
+                bm.set(table.assign(blob));
+            }
+        } else {
+            deserialize_header_from_file(comm, find_object(gitDir, id));
+        }
+        if (shallow.contains(id)) {
+            continue;
+        }
+        for (auto it = comm.parents.rbegin(); it != comm.parents.rend(); ++it) {
+            stack.push_back(*it);
+        }
+    }
+    return false;
+}
+
+// 按新的稀疏范围调整工作区：新纳入范围的跟踪文件写出，移出范围且未修改的删除，
+// 有未提交修改的文件留在原处
+void Repo::apply_sparse(const sparse::Cone& next) {
+    recover_basic_info();
+    recover_index();
+    Commit head;
+    ser::deserialize_from_file(head, find_object(gitDir, headCommitId));
+    auto tracked = std::move(head.mapping);
+    for (const auto& [k, v] : stageAdd) {
+        tracked[k] = v;
+    }
+    for (const auto& k : stageRemove) {
+        tracked.erase(k);
+    }
+    cone = next;
+    for (const auto& [name, blobId] : tracked) {
+        bool present = fs::is_regular_file(name);
+        if (next.contains(name)) {
+            if (!present) {
+                write_worktree(name, blobId);
+            }
+        } else if (present) {
+            string content;
+            Utils::readContentsAsString(content, name);
+            if (SHA1::sha1(content) == blobId) {
+                remove_worktree(name);
+            }
+        }
+    }
+}
+
+void Repo::sparse_set(const vector<string>& dirs) {
+    std::set<string> patterns;
+    for (const auto& dir : dirs) {
+        auto normalized = sparse::Cone::normalize(dir);
+        if (!normalized) {
+            Utils::exitWithMessage("Invalid sparse-checkout pattern.");
+        }
+        patterns.insert(std::move(*normalized));
+    }
+    ser::serialize_to_safe_file(patterns, sparseFile);
+    apply_sparse(sparse::Cone(patterns));
+}
+
+void Repo::sparse_disable() {
+    fs::remove(sparseFile);
+    fs::remove(sparseIndexFile);
+    fs::remove_all(sparseTreeDir);
+    apply_sparse(sparse::Cone());
+}
+
+void Repo::sparse_list() {
+    for (const auto& dir : sparse_cone().dirs()) {
+        cout << dir << '\n';
+    }
+}
+
+void Repo::pack_refs() {
+    refs.pack();
+}
+
+// 为每个分支的提交链建立位图：分支末端以及每隔 BITMAP_INTERVAL 个首父提交各存一张。
+// 已有位图的提交不再重建，所以重复执行只处理新增的历史。
+void Repo::build_bitmaps() {
+    constexpr size_t BITMAP_INTERVAL = 100;
+    recover_shallow_set();
+    bitmap::ObjectTable table(gitDir);
+    vector<std::pair<string, bitmap::Bitmap>> pending;
+    std::unordered_map<string, size_t> selected; // 本次新选中的提交 -> pending 下标
+    for (const auto& [_, tip] : refs.list()) {
+        // 沿首父链回溯到最近一个已有位图（或根、浅克隆边界）的提交
+        vector<string> chain;
+        bitmap::Bitmap bm;
+        Commit comm;
+        for (string id = tip; !fs::exists(bitmap_file(id));) {
+            if (auto it = selected.find(id); it != selected.end()) {
+                bm = pending[it->second].second;
+                break;
+            }
+            chain.push_back(id);
+            deserialize_header_from_file(comm, find_object(gitDir, id));
+            if (comm.parents.empty() || shallow.contains(id)) {
+                break;
+            }
+            id = comm.parents.front();
+        }
+        // 从旧到新累积：每个提交只需补上首父位图之外的部分
+        for (size_t i = chain.size(); i-- > 0;) {
+            reach_into(bm, table, {chain[i]}, true);
+            if (i == 0 || i % BITMAP_INTERVAL == 0) {
+                selected.emplace(chain[i], pending.size());
+                pending.emplace_back(chain[i], bm);
+            }
+        }
+    }
+    // 位图引用的编号必须先落盘
+    table.save();
+    for (const auto& [id, bm] : pending) {
+        auto file = bitmap_file(id);
+        fs::create_directories(file.parent_path());
+        Utils::writeContents(bm.encode(), file);
+    }
+}
+
+std::unordered_set<string> Repo::mark_reachable(const vector<string>& commits, unsigned jobs) {
+    std::optional<bitmap::ObjectTable> table;
+    if (fs::exists(gitDir / "bitmaps")) {
+        table.emplace(gitDir);
+    }
+    std::unordered_set<string> marked;
+    vector<string> frontier;
+    for (const auto& id : commits) {
+        if (marked.insert(id).second) {
+            frontier.push_back(id);
+        }
+    }
+    // 每个工作线程把读到的父提交与 blob 写进自己的输出，层与层之间再串行合并去重
+    struct Found {
+        vector<string> commits;
+        vector<string> objects; // blob，以及位图中直接给出的全部对象
+    };
+    vector<Found> found(std::max(1U, jobs));
+    vector<Commit> comms(found.size());
+    vector<string> buffers(found.size());
+    while (!frontier.empty()) {
+        scan::parallel_for(frontier.size(), jobs, [&](size_t i, unsigned worker) {
+            const string& id = frontier[i];
+            Found& out = found[worker];
+            if (auto stored = bitmap_file(id); table && fs::exists(stored)) {
+                Utils::readContentsAsString(buffers[worker], stored);
+                for (size_t pos : bitmap::Bitmap::decode(buffers[worker]).positions()) {
+                    if (pos >= table->size()) {
+                        throw std::invalid_argument("corrupt bitmap");
+                    }
+                    out.objects.push_back(table->id(pos));
+                }
+                return;
+            }
+            Commit& comm = comms[worker];
+            ser::deserialize_from_file(comm, find_object(gitDir, id));
+            for (const auto& [_, blob] : comm.mapping) {
+                out.objects.push_back(blob);
+            }
+            if (!shallow.contains(id)) {
+                out.commits.insert(out.commits.end(), comm.parents.begin(), comm.parents.end());
+            }
+        });
+        frontier.clear();
+        for (auto& out : found) {
+            for (auto& id : out.commits) {
+                if (marked.insert(id).second) {
+                    frontier.push_back(std::move(id));
+                }
+            }
+            for (auto& id : out.objects) {
+                marked.insert(std::move(id));
+            }
+            out.commits.clear();
+            out.objects.clear();
+        }
+    }
+    return marked;
+}
+
+void Repo::gc(std::chrono::system_clock::time_point expire) {
+    using clock = std::chrono::steady_clock;
+    auto millis = [](clock::time_point since) {
+        return std::chrono::duration<double, std::milli>(clock::now() - since).count();
+    };
+    recover_basic_info();
+    recover_index();
+    recover_commit_set();
+    recover_shallow_set();
+    const auto expireFile = fs::file_time_type::clock::from_sys(expire);
+
+    // 标记：所有分支（含远程跟踪分支）、暂存区，以及宽限期内的提交——
+    // 它们可能属于正在进行的操作，连同其祖先和 blob 一起保留
+    auto markStart = clock::now();
+    vector<string> roots;
+    for (const auto& [_, tip] : refs.list()) {
+        roots.push_back(tip);
+    }
+    for (const auto& id : allCommits) {
+        std::error_code ec;
+        auto mtime = fs::last_write_time(id_to_dir(id), ec);
+        if (!ec && mtime >= expireFile) {
+            roots.push_back(id);
+        }
+    }
+    auto marked = mark_reachable(roots, scan::default_jobs());
+    for (const auto& [_, blob] : stageAdd) {
+        marked.insert(blob);
+    }
+    cout << std::format("Marked {} reachable objects in {:.1f} ms.\n", marked.size(), millis(markStart));
+
+    // 清除：不可达且早于宽限期的对象
+    auto sweepStart = clock::now();
+    size_t pruned = 0;
+    uintmax_t bytes = 0;
+    vector<string> prunedCommits;
+    vector<string> kept;
+    for (const auto& dir : fs::directory_iterator(objDir)) {
+        if (!dir.is_directory()) {
+            continue;
+        }
+        string prefix = dir.path().filename().string();
+        for (const auto& entry : fs::directory_iterator(dir.path())) {
+            string id = prefix + entry.path().filename().string();
+            if (id.size() != Utils::UID_LENGTH) {
+                continue;
+            }
+            if (marked.contains(id) || entry.last_write_time() >= expireFile) {
+                kept.push_back(std::move(id));
+                continue;
+            }
+            bytes += entry.file_size();
+            fs::remove(entry.path());
+            ++pruned;
+            if (allCommits.erase(id) > 0) {
+                prunedCommits.push_back(std::move(id));
+            }
+        }
+        if (fs::is_empty(dir.path())) {
+            fs::remove(dir.path());
+        }
+    }
+    if (!prunedCommits.empty()) {
+        // 重读后再删除，gc 期间其他进程追加的提交得以保留
+        ser::update_file<std::set<string>>(commitSetFile, [&](std::set<string>& all) {
+            for (const auto& id : prunedCommits) {
+                all.erase(id);
+            }
+        });
+        // 消息索引里仍有被删提交，丢弃后由下一次 find 重建
+        fs::remove_all(gitDir / "msgindex");
+        for (const auto& id : prunedCommits) {
+            fs::remove(bitmap_file(id));
+        }
+    }
+    // 重建对象过滤器：去掉已删除对象留下的位，并按现有对象数重新定容量
+    bloom::Filter::create(objectFilterFile, kept);
+    object_filter(gitDir) = bloom::Filter(objectFilterFile);
+    cout << std::format("Pruned {} objects ({} bytes) in {:.1f} ms.\n", pruned, bytes, millis(sweepStart));
+}
+
+// 逐个对象重算哈希（大 blob 分块读入，不整体载入内存），再检查连通性：
+//   corrupt   哈希与文件名不符，或提交无法完整解码
+//   missing   被分支、暂存区或其他提交引用但本地不存在（部分克隆缺少的 blob 除外）
+//   unlisted  完好的提交，但不在 COMMITS 中（写入提交与登记 COMMITS 之间中断）
+//   dangling  存在但没有任何分支、暂存区或提交引用
+void Repo::fsck(bool quick) {
+    recover_basic_info();
+    recover_index();
+    recover_commit_set();
+    recover_shallow_set();
+    const bool partial = fs::exists(promisorFile);
+
+    vector<string> ids;
+    for (const auto& dir : fs::directory_iterator(objDir)) {
+        if (!dir.is_directory()) {
+            continue;
+        }
+        string prefix = dir.path().filename().string();
+        for (const auto& entry : fs::directory_iterator(dir.path())) {
+            ids.push_back(prefix + entry.path().filename().string());
+        }
+    }
+    std::ranges::sort(ids);
+
+    struct Checked {
+        bool corrupt = false;
+        bool commit = false;
+        vector<string> parents;
+        vector<string> blobs;
+    };
+    vector<Checked> checked(ids.size());
+    const unsigned jobs = scan::default_jobs();
+    vector<string> buffers(jobs);
+    scan::parallel_for(ids.size(), jobs, [&](size_t i, unsigned worker) {
+        const string& id = ids[i];
+        Checked& out = checked[i];
+        string& buf = buffers[worker];
+        if (id.size() != Utils::UID_LENGTH) {
+            out.corrupt = true;
+            return;
+        }
+        std::ifstream in(id_to_dir(id), std::ios::binary);
+        buf.resize(ser::READ_CHUNK);
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.resize(static_cast<size_t>(in.gcount()));
+        // 提交对象以长度前缀加自身 ID 开头：按内容识别提交，不依赖 COMMITS 是否登记了它
+        const bool listed = allCommits.contains(id);
+        const bool tagged = buf.size() >= sizeof(size_t) + id.size() &&
+                            buf.compare(0, sizeof(size_t), ser::serialize(id.size())) == 0 &&
+                            buf.compare(sizeof(size_t), id.size(), id) == 0;
+        if (listed || tagged) {
+            buf.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            // --quick 只对 COMMITS 中的提交省去重算哈希；未登记的对象必须哈希相符才算提交
+            Commit comm;
+            if (decode_commit(buf, id, comm, !quick || !listed)) {
+                out.commit = true;
+                if (!shallow.contains(id)) {
+                    out.parents = std::move(comm.parents);
+                }
+                for (auto& [_, blob] : comm.mapping) {
+                    out.blobs.push_back(std::move(blob));
+                }
+                return;
+            }
+            if (listed) {
+                out.commit = true;
+                out.corrupt = true;
+                return;
+            }
+        }
+        if (quick) {
+            return;
+        }
+        SHA1::Context ctx;
+        ctx.update(buf);
+        buf.resize(ser::READ_CHUNK);
+        while (in.read(buf.data(), static_cast<std::streamsize>(buf.size())) || in.gcount() > 0) {
+            ctx.update(string_view(buf.data(), static_cast<size_t>(in.gcount())));
+        }
+        out.corrupt = ctx.digest() != id;
+    });
+
+    std::set<std::pair<string, string>> missing; // (id, 类型)
+    std::unordered_set<string> referenced;
+    const std::unordered_set<string> present(ids.begin(), ids.end());
+    // 借自 alternates 的对象只确认存在，由拥有它们的仓库负责校验
+    const bool borrowed = !alternates(gitDir).empty();
+    auto have = [&](const string& id) {
+        return present.contains(id) || (borrowed && fs::exists(find_object(gitDir, id)));
+    };
+    auto reference = [&](const string& id, bool commit) {
+        referenced.insert(id);
+        if (!have(id) && (commit || !partial)) {
+            missing.emplace(id, commit ? "commit" : "blob");
+        }
+    };
+    for (const auto& [_, tip] : refs.list()) {
+        reference(tip, true);
+    }
+    for (const auto& [_, blob] : stageAdd) {
+        reference(blob, false);
+    }
+    for (const auto& id : allCommits) {
+        if (!have(id)) {
+            missing.emplace(id, "commit");
+        }
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (checked[i].corrupt) {
+            continue;
+        }
+        for (const auto& parent : checked[i].parents) {
+            reference(parent, true);
+        }
+        for (const auto& blob : checked[i].blobs) {
+            reference(blob, false);
+        }
+    }
+
+    auto kind = [&](size_t i) { return checked[i].commit ? "commit" : "blob"; };
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (checked[i].corrupt) {
+            cout << "corrupt " << kind(i) << ' ' << ids[i] << '\n';
+        }
+    }
+    for (const auto& [id, type] : missing) {
+        cout << "missing " << type << ' ' << id << '\n';
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (checked[i].commit && !checked[i].corrupt && !allCommits.contains(ids[i])) {
+            cout << "unlisted commit " << ids[i] << '\n';
+        }
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (!referenced.contains(ids[i]) && !checked[i].corrupt) {
+            cout << "dangling " << kind(i) << ' ' << ids[i] << '\n';
+        }
+    }
+}
+
+bool Repo::in_history(string_view tip, string_view ancestor) {
+    // 本地根本没有这个提交，自然不在历史中，无需遍历。
+    // 这里的回答决定 push 是否放行，不能用可能误答"没有"的对象过滤器
+    if (!fs::exists(find_object(gitDir, ancestor))) {
+        return false;
+    }
+    if (fs::exists(gitDir / "bitmaps")) {
+        bitmap::ObjectTable table(gitDir);
+        bitmap::Bitmap bm;
+        // 遇到 ancestor（或含有它的已存位图）即停止，祖先离 tip 很近时不必遍历整段历史
+        return reach_into(bm, table, {string(tip)}, false, table.assign(string(ancestor)));
+    }
+    std::unordered_set<string> visited{string(tip)};
+    std::queue<string> q;
+    q.emplace(tip);
+    Commit comm;
+    while (!q.empty()) {
+        string id = std::move(q.front());
+        q.pop();
+        if (id == ancestor) {
+            return true;
+        }
+        if (shallow.contains(id)) {
+            continue;
+        }
+        deserialize_header_from_file(comm, find_object(gitDir, id));
+        for (const auto& p : comm.parents) {
+            if (visited.insert(p).second) {
+                q.push(p);
+            }
+        }
+    }
+    return false;
+}
+
+// 从 src 的 tip 出发遍历提交图，遇到对方已有（have）的提交即停止（它的祖先对方也必然都有）。
+// 这些边界提交引用的 blob 记入 haveBlobs，之后无需再检查或传输。
+std::vector<Commit> Repo::missing_commits(const path& srcGit,
+                                          string_view tip,
+                                          const std::function<bool(const string&)>& have,
+                                          std::unordered_set<string>& haveBlobs) {
+    // 浅克隆的边界提交没有本地父提交，不再向下遍历
+    std::set<string> srcShallow;
+    if (fs::exists(srcGit / "SHALLOW")) {
+        ser::deserialize_from_file(srcShallow, srcGit / "SHALLOW");
+    }
+    vector<Commit> missing;
+    std::unordered_set<string> visited{string(tip)};
+    std::queue<string> q;
+    q.emplace(tip);
+    while (!q.empty()) {
+        string id = std::move(q.front());
+        q.pop();
+        Commit comm;
+        ser::deserialize_from_file(comm, find_object(srcGit, id));
+        if (have(id)) {
+            for (auto& [_, blob] : comm.mapping) {
+                haveBlobs.insert(std::move(blob));
+            }
+            continue;
+        }
+        for (const auto& p : comm.parents) {
+            if (!srcShallow.contains(id) && visited.insert(p).second) {
+                q.push(p);
+            }
+        }
+        missing.push_back(std::move(comm));
+    }
+    // 祖先在前，保证中途失败时 dst 中已有的提交历史仍然完整
+    std::ranges::reverse(missing);
+    return missing;
+}
+
+void Repo::copy_objects(const path& srcGit, const path& dstGit, vector<string> ids, bool link) {
+    // 排序后同一扇出目录的对象相邻，每个目录只创建一次
+    std::ranges::sort(ids);
+    string fanout;
+    vector<string> copied;
+    for (const auto& id : ids) {
+        if (id.compare(0, 2, fanout) != 0) {
+            fanout = id.substr(0, 2);
+            fs::create_directories(dstGit / "objects" / fanout);
+        }
+        // 先看目标（含其 alternates）：部分克隆推送时源端可能没有目标早已拥有的 blob
+        if (has_object(dstGit, id)) {
+            continue;
+        }
+        // 对象写入后不再修改（改写都是新文件改名覆盖），因此可以与源仓库共享同一份数据。
+        // 过滤器可能误答没有（其他进程同时置位或重建），目标已存在时跳过
+        if (link) {
+            Utils::linkOrCopy(find_object(srcGit, id), id_to_dir(dstGit, id));
+        } else {
+            fs::copy_file(find_object(srcGit, id), id_to_dir(dstGit, id), fs::copy_options::skip_existing);
+        }
+        copied.push_back(id);
+    }
+    record_objects(dstGit, copied);
+}
+
+void Repo::transfer_objects(const path& srcGit,
+                            const path& dstGit,
+                            const vector<Commit>& commits,
+                            std::unordered_set<string>& haveBlobs) {
+    vector<string> blobs;
+    vector<string> ids;
+    ids.reserve(commits.size());
+    for (const auto& comm : commits) {
+        ids.push_back(comm.id);
+        for (const auto& [_, blob] : comm.mapping) {
+            if (haveBlobs.insert(blob).second) {
+                blobs.push_back(blob);
+            }
+        }
+    }
+    // 先 blob 后提交，最后才登记提交集合
+    copy_objects(srcGit, dstGit, std::move(blobs));
+    copy_objects(srcGit, dstGit, ids);
+    if (!ids.empty()) {
+        ser::append_to_set_file(ids, dstGit / "COMMITS");
+        vector<std::pair<string, string>> entries;
+        entries.reserve(commits.size());
+        for (const auto& comm : commits) {
+            entries.emplace_back(comm.id, comm.message);
+        }
+        index_messages(dstGit, entries);
+    }
+}
+
+void Repo::push(con_string remoteName, con_string remoteBranch) {
+    fs::path remoteGit = remote_git_dir(remoteName);
+    recover_basic_info();
+    recover_shallow_set();
+
+    // 空串表示远程分支尚不存在
+    string remoteHead = RefStore(remoteGit).read(remoteBranch).value_or("");
+    if (!remoteHead.empty()) {
+        if (!in_history(headCommitId, remoteHead)) {
+            Utils::exitWithMessage("Please pull down remote changes before pushing.");
+        }
+    }
+
+    std::unordered_set<string> haveBlobs;
+    auto commits = missing_commits(
+        gitDir, headCommitId, [&](const string& id) { return has_object(remoteGit, id); }, haveBlobs);
+    transfer_objects(gitDir, remoteGit, commits, haveBlobs);
+
+    // 对象先于引用写入；检查之后远程分支又被别人推进时，不覆盖对方的提交
+    if (!update_ref(remoteGit, remoteBranch, headCommitId, remoteHead)) {
+        Utils::exitWithMessage("Please pull down remote changes before pushing.");
+    }
+}
+
+void Repo::fetch(con_string remoteName, con_string remoteBranch) {
+    fs::path remoteGit = remote_git_dir(remoteName);
+    auto remoteRef = RefStore(remoteGit).read(remoteBranch);
+    if (!remoteRef) {
+        Utils::exitWithMessage("That remote does not have that branch.");
+    }
+    string remoteHead = *remoteRef;
+
+    std::unordered_set<string> haveBlobs;
+    auto commits = missing_commits(
+        remoteGit, remoteHead, [](const string& id) { return has_object(gitDir, id); }, haveBlobs);
+    transfer_objects(remoteGit, gitDir, commits, haveBlobs);
+
+    // 远程分支在本地以 [remote name]/[remote branch name] 的名字保存
+    update_branch(format("{}/{}", remoteName, remoteBranch), remoteHead);
+}
+
+void Repo::pull(con_string remoteName, con_string remoteBranch) {
+    fetch(remoteName, remoteBranch);
+    merge(format("{}/{}", remoteName, remoteBranch));
+}
+
+void Repo::bundle_create(con_string file, con_string branch, const optional<string>& base, bool compress) {
+    auto tip = refs.read(branch);
+    if (!tip) {
+        Utils::exitWithMessage("A branch with that name does not exist.");
+    }
+    bundle::Header header;
+    header.branch = branch;
+    header.compressed = compress;
+    header.tip = *tip;
+
+    // base 的全部祖先都视为接收方已有
+    std::unordered_set<string> excluded;
+    std::optional<std::pair<bitmap::ObjectTable, bitmap::Bitmap>> excludedBits;
+    if (base) {
+        auto baseId = resolve_commit(*base);
+        if (!baseId) {
+            Utils::exitWithMessage("No commit with that id exists.");
+        }
+        header.prerequisites.push_back(*baseId);
+        recover_shallow_set();
+        if (fs::exists(gitDir / "bitmaps")) {
+            auto& [table, bm] = excludedBits.emplace(bitmap::ObjectTable(gitDir), bitmap::Bitmap());
+            reach_into(bm, table, {*baseId}, false);
+        } else {
+            std::queue<string> q;
+            q.push(*baseId);
+            excluded.insert(*baseId);
+            Commit comm;
+            while (!q.empty()) {
+                string id = std::move(q.front());
+                q.pop();
+                if (shallow.contains(id)) {
+                    continue;
+                }
+                deserialize_header_from_file(comm, find_object(gitDir, id));
+                for (const auto& p : comm.parents) {
+                    if (excluded.insert(p).second) {
+                        q.push(p);
+                    }
+                }
+            }
+        }
+    }
+
+    std::unordered_set<string> haveBlobs;
+    auto commits = missing_commits(
+        gitDir,
+        header.tip,
+        [&](const string& id) {
+            if (excludedBits) {
+                auto pos = excludedBits->first.find(id);
+                return pos && excludedBits->second.test(*pos);
+            }
+            return excluded.contains(id);
+        },
+        haveBlobs);
+
+    // 逐个对象流式写出：先 blob，后提交（祖先在前）
+    bundle::Writer writer(file, header);
+    string content;
+    for (const auto& comm : commits) {
+        for (const auto& [_, blob] : comm.mapping) {
+            if (haveBlobs.insert(blob).second) {
+                Utils::readContentsAsString(content, ensure_object(blob));
+                writer.add(bundle::ObjectKind::Blob, blob, content);
+            }
+        }
+    }
+    for (const auto& comm : commits) {
+        Utils::readContentsAsString(content, find_object(gitDir, comm.id));
+        writer.add(bundle::ObjectKind::Commit, comm.id, content);
+    }
+    writer.finish();
+}
+
+void Repo::bundle_unbundle(con_string file) {
+    recover_commit_set();
+    vector<string> ids;
+    vector<std::pair<string, string>> messages;
+    vector<string> written;
+    string tip;
+    string branch;
+    try {
+        bundle::Reader reader(file);
+        for (const auto& p : reader.header().prerequisites) {
+            if (!allCommits.contains(p)) {
+                Utils::exitWithMessage(format("Repository lacks prerequisite commit {}.", p));
+            }
+        }
+        // 每个对象都按内容重算 ID 后才写入，且写入留在事务中：整个 bundle 的校验和通过之前
+        // 不改名到对象库；出错时事务随异常析构，临时文件全部丢弃
+        durable::Transaction tx;
+        bundle::ObjectKind kind;
+        string id;
+        string content;
+        Commit comm;
+        while (reader.next(kind, id, content)) {
+            // ID 会成为对象路径：只接受 40 位十六进制
+            if (!Utils::isObjectId(id)) {
+                throw GitliteException("Bundle is corrupt.");
+            }
+            bool valid = kind == bundle::ObjectKind::Commit ? decode_commit(content, id, comm)
+                                                            : SHA1::sha1(content) == id;
+            if (!valid) {
+                throw GitliteException("Bundle is corrupt.");
+            }
+            if (!has_object(gitDir, id)) {
+                Utils::writeContents(content, id_to_dir(id));
+                written.push_back(id);
+            }
+            if (kind == bundle::ObjectKind::Commit && !allCommits.contains(id)) {
+                ids.push_back(id);
+                messages.emplace_back(id, std::move(comm.message));
+            }
+        }
+        if (!reader.verify()) {
+            throw GitliteException("Bundle is corrupt.");
+        }
+        tip = reader.header().tip;
+        branch = reader.header().branch;
+        if (!Utils::isObjectId(tip) || branch.empty() || branch.find("..") != string::npos) {
+            throw GitliteException("Bundle is corrupt.");
+        }
+        tx.commit();
+    } catch (const GitliteException& e) {
+        Utils::exitWithMessage(e.what());
+    }
+    record_objects(gitDir, written);
+
+    if (!ids.empty()) {
+        ser::append_to_set_file(ids, commitSetFile);
+        index_messages(gitDir, messages);
+    }
+    // 与 fetch 相同，以 bundle/[branch name] 的名字保存
+    update_branch(format("bundle/{}", branch), tip);
+}
+
+void Repo::clone(con_string source, con_string directory, int depth, bool blobless, bool shared) {
+    fs::path srcGit = fs::absolute(fs::path(source).make_preferred());
+    if (!fs::is_directory(srcGit / "objects")) {
+        Utils::exitWithMessage("Remote directory not found.");
+    }
+    if (fs::exists(directory) && !fs::is_empty(directory)) {
+        Utils::exitWithMessage("Destination path already exists and is not an empty directory.");
+    }
+    fs::create_directories(directory);
+    fs::current_path(directory);
+    create_layout();
+
+    string branch;
+    ser::deserialize_from_file(branch, srcGit / "HEAD");
+    string tip = RefStore(srcGit).read(branch).value();
+    std::set<string> srcShallow;
+    if (fs::exists(srcGit / "SHALLOW")) {
+        ser::deserialize_from_file(srcShallow, srcGit / "SHALLOW");
+    }
+
+    // 按代数广度优先：第 depth 代仍有父提交的提交成为浅克隆边界
+    std::unordered_map<string, int> level{{tip, 1}};
+    std::queue<string> q;
+    q.push(tip);
+    vector<string> commitIds;
+    vector<std::pair<string, string>> messages;
+    vector<string> blobs;
+    std::unordered_set<string> seenBlobs;
+    Commit comm;
+    while (!q.empty()) {
+        string id = std::move(q.front());
+        q.pop();
+        ser::deserialize_from_file(comm, find_object(srcGit, id));
+        commitIds.push_back(id);
+        messages.emplace_back(id, comm.message);
+        if (!blobless) {
+            for (const auto& [_, blob] : comm.mapping) {
+                if (seenBlobs.insert(blob).second) {
+                    blobs.push_back(blob);
+                }
+            }
+        }
+        if (comm.parents.empty()) {
+            continue;
+        }
+        if (srcShallow.contains(id) || (depth > 0 && level[id] >= depth)) {
+            shallow.insert(id);
+            continue;
+        }
+        int next = level[id] + 1;
+        for (const auto& p : comm.parents) {
+            if (level.emplace(p, next).second) {
+                q.push(p);
+            }
+        }
+    }
+
+    if (shared) {
+        // 不复制任何对象，直接借用源仓库（及其 alternates）的对象目录
+        vector<string> dirs{(srcGit / "objects").string()};
+        for (const auto& alt : alternates(srcGit)) {
+            dirs.push_back(alt.string());
+        }
+        ser::serialize_to_file(dirs, alternatesFile);
+    } else {
+        copy_objects(srcGit, gitDir, std::move(blobs), true);
+        copy_objects(srcGit, gitDir, commitIds, true);
+    }
+
+    allCommits.insert(commitIds.begin(), commitIds.end());
+    persist_commit_set();
+    index_messages(gitDir, messages);
+    update_branch(branch, tip);
+    update_head(branch);
+    remotes.emplace("origin", srcGit.string());
+    persist_remote_set();
+    if (!shallow.empty()) {
+        ser::serialize_to_file(shallow, shallowFile);
+    }
+    if (blobless && !shared) {
+        ser::serialize_to_file(srcGit.string(), promisorFile);
+        promisor = srcGit;
+    }
+
+    // 检出分支头：部分克隆在这里按需取回所需的 blob
+    ser::deserialize_from_file(comm, find_object(gitDir, tip));
+    for (const auto& [name, blobId] : comm.mapping) {
+        write_worktree(name, blobId);
+    }
+}
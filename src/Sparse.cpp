@@ -0,0 +1,218 @@
+#include "Sparse.h"
+#include "Serialization.hpp"
+#include "Durable.h"
+#include "Utils.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace sparse {
+
+Cone::Cone(const std::set<std::string>& dirs) {
+    for (const auto& dir : dirs) {
+        add(dir);
+    }
+}
+
+std::optional<std::string> Cone::normalize(std::string_view dir) {
+    while (dir.starts_with("./")) {
+        dir.remove_prefix(2);
+    }
+    while (dir.ends_with('/')) {
+        dir.remove_suffix(1);
+    }
+    if (dir.empty() || dir == "." || dir.starts_with('/')) {
+        return std::nullopt;
+    }
+    std::string out;
+    size_t start = 0;
+    while (start <= dir.size()) {
+        size_t slash = std::min(dir.find('/', start), dir.size());
+        auto part = dir.substr(start, slash - start);
+        if (part == "..") {
+            return std::nullopt;
+        }
+        // 连续的 '/' 与中间的 "." 直接略去
+        if (!part.empty() && part != ".") {
+            if (!out.empty()) {
+                out += '/';
+            }
+            out += part;
+        }
+        start = slash + 1;
+    }
+    if (out.empty()) {
+        return std::nullopt;
+    }
+    return out;
+}
+
+void Cone::add(std::string_view dir) {
+    patterns.emplace(dir);
+    size_t node = 0;
+    size_t start = 0;
+    while (start <= dir.size()) {
+        size_t slash = std::min(dir.find('/', start), dir.size());
+        auto part = dir.substr(start, slash - start);
+        auto it = nodes[node].children.find(part);
+        if (it == nodes[node].children.end()) {
+            nodes.emplace_back();
+            it = nodes[node].children.emplace(std::string(part), nodes.size() - 1).first;
+        }
+        node = it->second;
+        start = slash + 1;
+    }
+    nodes[node].recursive = true;
+}
+
+size_t Cone::outside_prefix(std::string_view path) const {
+    if (patterns.empty()) {
+        return 0;
+    }
+    // 沿目录部分逐级下行：走到文件所在目录（模式目录的祖先）或遇到模式目录即包含；
+    // 第一个不在字典树中的目录整个位于范围之外
+    const Node* node = &nodes.front();
+    size_t start = 0;
+    while (true) {
+        size_t slash = path.find('/', start);
+        if (slash == std::string_view::npos) {
+            return 0;
+        }
+        auto it = node->children.find(path.substr(start, slash - start));
+        if (it == node->children.end()) {
+            return slash + 1;
+        }
+        node = &nodes[it->second];
+        if (node->recursive) {
+            return 0;
+        }
+        start = slash + 1;
+    }
+}
+
+namespace {
+
+// 折叠目录的树文件：跳过开头的条目数，剩下的就是按序排列的键值对
+std::ifstream open_tree(const std::filesystem::path& file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::invalid_argument("missing sparse index tree");
+    }
+    return in;
+}
+
+} // namespace
+
+Index Index::build(std::string commit,
+                   const Cone& cone,
+                   const std::map<std::string, std::string>& mapping,
+                   const std::filesystem::path& treeDir) {
+    Index index;
+    index.commit = std::move(commit);
+    index.patterns = cone.dirs();
+    std::filesystem::create_directories(treeDir);
+    // 同一目录下的路径在有序映射中是连续的：逐组收集，遇到下一组时写出上一组
+    std::string dir;
+    std::map<std::string, std::string> group;
+    auto flush = [&] {
+        if (group.empty()) {
+            return;
+        }
+        auto bytes = ser::serialize(group);
+        auto id = SHA1::sha1(bytes);
+        // 树文件按内容命名，写好即可被同一事务中随后的提交读取，因此不等事务提交
+        if (!std::filesystem::exists(treeDir / id)) {
+            auto tmp = durable::temp_path(treeDir / id);
+            std::ofstream(tmp, std::ios::binary) << bytes;
+            std::filesystem::rename(tmp, treeDir / id);
+        }
+        index.entries.emplace(dir, std::move(id));
+        index.sizes.emplace(dir, group.size());
+        group.clear();
+    };
+    for (const auto& [path, blob] : mapping) {
+        size_t prefix = cone.outside_prefix(path);
+        if (prefix == 0) {
+            flush();
+            index.entries.emplace(path, blob);
+            continue;
+        }
+        if (group.empty() || path.compare(0, prefix, dir) != 0) {
+            flush();
+            dir = path.substr(0, prefix);
+        }
+        group.emplace(path, blob);
+    }
+    flush();
+    return index;
+}
+
+std::optional<std::string> Index::collapsed(std::string_view path) const {
+    for (size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', slash + 1)) {
+        auto dir = std::string(path.substr(0, slash + 1));
+        if (sizes.contains(dir)) {
+            return dir;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::string> Index::find(std::string_view path, const std::filesystem::path& treeDir) const {
+    if (auto it = entries.find(std::string(path)); it != entries.end()) {
+        return it->second;
+    }
+    auto dir = collapsed(path);
+    if (!dir) {
+        return std::nullopt;
+    }
+    std::map<std::string, std::string> tree;
+    auto in = open_tree(treeDir / entries.at(*dir));
+    ser::deserialize(tree, in);
+    auto it = tree.find(std::string(path));
+    return it == tree.end() ? std::nullopt : std::make_optional(it->second);
+}
+
+void Index::expand(const std::string& dir, const std::filesystem::path& treeDir) {
+    std::map<std::string, std::string> tree;
+    auto in = open_tree(treeDir / entries.at(dir));
+    ser::deserialize(tree, in);
+    entries.erase(dir);
+    sizes.erase(dir);
+    entries.merge(tree);
+}
+
+void Index::write_mapping(std::ostream& out, const std::filesystem::path& treeDir) const {
+    size_t total = entries.size() - sizes.size();
+    for (const auto& [_, n] : sizes) {
+        total += n;
+    }
+    ser::serialize(total, out);
+    // "<dir>/" 排在该目录所有路径之前，且目录已整体折叠，其间不会夹着别的条目
+    for (const auto& [path, id] : entries) {
+        if (!path.ends_with('/')) {
+            ser::serialize(path, out);
+            ser::serialize(id, out);
+            continue;
+        }
+        auto in = open_tree(treeDir / id);
+        in.seekg(sizeof(size_t));
+        out << in.rdbuf();
+    }
+}
+
+void serialize(const Index& obj, std::ostream& out) {
+    ser::serialize(obj.commit, out);
+    ser::serialize(obj.patterns, out);
+    ser::serialize(obj.entries, out);
+    ser::serialize(obj.sizes, out);
+}
+
+void deserialize(Index& obj, std::istream& in) {
+    ser::deserialize(obj.commit, in);
+    ser::deserialize(obj.patterns, in);
+    ser::deserialize(obj.entries, in);
+    ser::deserialize(obj.sizes, in);
+}
+
+} // namespace sparse
@@ -0,0 +1,76 @@
+#include "StatCache.h"
+#include "Serialization.hpp"
+#include "Utils.h"
+#include <chrono>
+
+namespace fs = std::filesystem;
+
+namespace worktree {
+
+void serialize(const Stat& obj, std::ostream& out) {
+    ser::serialize(obj.size, out);
+    ser::serialize(obj.mtime, out);
+    ser::serialize(obj.blob, out);
+}
+
+void deserialize(Stat& obj, std::istream& in) {
+    ser::deserialize(obj.size, in);
+    ser::deserialize(obj.mtime, in);
+    ser::deserialize(obj.blob, in);
+}
+
+StatCache::StatCache(fs::path cacheFile) : file(std::move(cacheFile)) {
+    if (fs::exists(file)) {
+        ser::deserialize_from_file(entries, file);
+    }
+}
+
+std::optional<std::string> StatCache::blob_id(const std::string& path) {
+    using namespace std::chrono_literals;
+    std::error_code ec;
+    fs::directory_entry entry(path, ec);
+    if (ec || !entry.is_regular_file(ec)) {
+        return std::nullopt;
+    }
+    Stat now;
+    now.size = static_cast<std::int64_t>(entry.file_size(ec));
+    auto mtime = entry.last_write_time(ec);
+    if (ec) {
+        return std::nullopt; // 检查期间被删除
+    }
+    now.mtime = static_cast<std::int64_t>(mtime.time_since_epoch().count());
+    seen.insert(path);
+    auto it = entries.find(path);
+    if (it != entries.end() && it->second.size == now.size && it->second.mtime == now.mtime) {
+        return it->second.blob;
+    }
+    std::string content;
+    Utils::readContentsAsString(content, path);
+    now.blob = SHA1::sha1(content);
+    // 刚修改过的文件不缓存，下次仍重新计算
+    if (mtime < fs::file_time_type::clock::now() - 1s) {
+        entries[path] = now;
+        dirty = true;
+    } else if (it != entries.end()) {
+        entries.erase(it);
+        dirty = true;
+    }
+    return now.blob;
+}
+
+void StatCache::save() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (seen.contains(it->first)) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+            dirty = true;
+        }
+    }
+    if (dirty) {
+        ser::serialize_to_safe_file(entries, file);
+        dirty = false;
+    }
+}
+
+} // namespace worktree
@@ -0,0 +1,98 @@
+#include "Untracked.h"
+#include "Serialization.hpp"
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+namespace fs = std::filesystem;
+
+namespace untracked {
+
+void serialize(const Dir& obj, std::ostream& out) {
+    ser::serialize(obj.mtime, out);
+    ser::serialize(obj.files, out);
+    ser::serialize(obj.dirs, out);
+}
+
+void deserialize(Dir& obj, std::istream& in) {
+    ser::deserialize(obj.mtime, in);
+    ser::deserialize(obj.files, in);
+    ser::deserialize(obj.dirs, in);
+}
+
+Cache::Cache(fs::path cacheFile) : file(std::move(cacheFile)) {
+    if (fs::exists(file)) {
+        ser::deserialize_from_file(entries, file);
+    }
+}
+
+void Cache::scan(const std::function<bool(const std::string& dir)>& skipDir,
+                 const std::function<void(const std::string& path)>& visit) {
+    using namespace std::chrono_literals;
+    // 修改时间与扫描开始时刻过于接近的目录不缓存：同一时钟刻度内的再次修改不会改变 mtime
+    const auto racy = fs::file_time_type::clock::now() - 1s;
+    std::set<std::string> seen; // 本次访问且留在缓存中的目录
+    std::vector<std::string> pending{""};
+    while (!pending.empty()) {
+        std::string dir = std::move(pending.back());
+        pending.pop_back();
+        fs::path p = dir.empty() ? fs::path(".") : fs::path(dir);
+        std::error_code ec;
+        auto mtime = fs::last_write_time(p, ec);
+        if (ec) {
+            continue; // 扫描期间被删除
+        }
+        auto stamp = static_cast<std::int64_t>(mtime.time_since_epoch().count());
+        Dir fresh;
+        const Dir* listing = &fresh;
+        if (auto it = entries.find(dir); it != entries.end() && it->second.mtime == stamp) {
+            listing = &it->second;
+            seen.insert(dir);
+        } else {
+            // 目录有变化或尚未缓存：重新读取
+            fresh.mtime = stamp;
+            for (const auto& entry : fs::directory_iterator(p)) {
+                auto name = entry.path().filename().string();
+                if (dir.empty() && name == ".gitlite") {
+                    continue;
+                }
+                (entry.is_directory() ? fresh.dirs : fresh.files).push_back(std::move(name));
+            }
+            std::ranges::sort(fresh.files);
+            std::ranges::sort(fresh.dirs);
+            if (mtime < racy) {
+                listing = &(entries[dir] = std::move(fresh));
+                seen.insert(dir);
+                dirty = true;
+            }
+        }
+        auto prefix = dir.empty() ? dir : dir + '/';
+        for (const auto& name : listing->files) {
+            visit(prefix + name);
+        }
+        for (const auto& name : listing->dirs) {
+            auto sub = prefix + name;
+            if (!skipDir(sub)) {
+                pending.push_back(std::move(sub));
+            }
+        }
+    }
+    // 已删除或本次未访问的目录不再保留
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (seen.contains(it->first)) {
+            ++it;
+        } else {
+            it = entries.erase(it);
+            dirty = true;
+        }
+    }
+}
+
+void Cache::save() {
+    if (dirty) {
+        ser::serialize_to_safe_file(entries, file);
+        dirty = false;
+    }
+}
+
+} // namespace untracked
@@ -1,4 +1,7 @@
 #include "Utils.h"
+#include "Durable.h"
+#include <algorithm>
+#include <cerrno>
 #include <cstddef>
 #include <cstdlib>
 #include <cstring>
@@ -8,6 +11,12 @@
 #include <iostream>
 #include <stdexcept>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -132,6 +141,101 @@ std::string sha1(std::string_view s1, std::string_view s2) {
     return sha1(all);
 }
 
+Context::Context() : H{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}, block{} {}
+
+void Context::transform(const uint8_t* chunk) {
+    uint32_t W[80];
+    for (int i = 0; i < 16; i++) {
+        W[i] = (uint32_t(chunk[4 * i]) << 24) | (uint32_t(chunk[4 * i + 1]) << 16) | (uint32_t(chunk[4 * i + 2]) << 8) |
+               uint32_t(chunk[4 * i + 3]);
+    }
+    for (int i = 16; i < 80; i++) {
+        uint32_t x = W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16];
+        W[i] = (x << 1) | (x >> 31);
+    }
+    uint32_t a = H[0], b = H[1], c = H[2], d = H[3], e = H[4];
+    for (int j = 0; j < 80; j++) {
+        uint32_t f;
+        uint32_t k;
+        if (j < 20) {
+            f = (b & c) | ((~b) & d);
+            k = 0x5a827999;
+        } else if (j < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (j < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        uint32_t temp = ((a << 5) | (a >> 27)) + f + e + k + W[j];
+        e = d;
+        d = c;
+        c = (b << 30) | (b >> 2);
+        b = a;
+        a = temp;
+    }
+    H[0] += a;
+    H[1] += b;
+    H[2] += c;
+    H[3] += d;
+    H[4] += e;
+}
+
+void Context::update(std::string_view data) {
+    length += data.size();
+    const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+    size_t n = data.size();
+    if (used > 0) {
+        size_t take = std::min(n, 64 - used);
+        std::memcpy(block + used, p, take);
+        used += take;
+        p += take;
+        n -= take;
+        if (used < 64) {
+            return;
+        }
+        transform(block);
+        used = 0;
+    }
+    for (; n >= 64; p += 64, n -= 64) {
+        transform(p);
+    }
+    std::memcpy(block, p, n);
+    used = n;
+}
+
+// Produces the same ids as SHA::sha, including its padding for lengths of 56 (mod 64),
+// where the length field overwrites the 0x80 marker instead of starting a new block.
+std::string Context::digest() {
+    uint64_t bits = length * 8;
+    if (used != 56) {
+        block[used++] = 0x80;
+    }
+    if (used > 56) {
+        std::memset(block + used, 0, 64 - used);
+        transform(block);
+        used = 0;
+    }
+    std::memset(block + used, 0, 56 - used);
+    for (int i = 0; i < 8; i++) {
+        block[63 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    transform(block);
+    used = 0;
+
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string out(40, '0');
+    for (int i = 0; i < 20; i++) {
+        uint8_t byte = H[i / 4] >> (24 - 8 * (i % 4));
+        out[2 * i] = hex[byte >> 4];
+        out[2 * i + 1] = hex[byte & 0xF];
+    }
+    return out;
+}
+
 std::string sha1(std::string_view s1, std::string_view s2, std::string_view s3, std::string_view s4) {
     std::string all;
     all.reserve(s1.size() + s2.size() + s3.size() + s4.size());
@@ -143,6 +247,135 @@ std::string sha1(std::string_view s1, std::string_view s2, std::string_view s3,
 }
 } // namespace SHA1
 
+// LZ compression
+// A stream of sequences: token (literal length << 4 | match length - 4), literals, 2-byte offset.
+// Lengths of 15 continue in following bytes (255 means "keep adding"). The last sequence has no match.
+namespace LZ {
+namespace {
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 14;
+
+uint32_t load32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+void put_length(std::string& out, size_t len) {
+    for (; len >= 255; len -= 255) {
+        out.push_back(static_cast<char>(255));
+    }
+    out.push_back(static_cast<char>(len));
+}
+
+size_t get_length(std::string_view src, size_t& pos, size_t base) {
+    if (base != 15) {
+        return base;
+    }
+    size_t len = base;
+    while (true) {
+        if (pos >= src.size()) {
+            throw std::invalid_argument("corrupt compressed data");
+        }
+        auto byte = static_cast<uint8_t>(src[pos++]);
+        len += byte;
+        if (byte != 255) {
+            return len;
+        }
+    }
+}
+
+void put_sequence(std::string& out, std::string_view literals, size_t offset, size_t match) {
+    size_t lit = literals.size();
+    size_t ml = match == 0 ? 0 : match - MIN_MATCH;
+    out.push_back(static_cast<char>((std::min<size_t>(lit, 15) << 4) | std::min<size_t>(ml, 15)));
+    if (lit >= 15) {
+        put_length(out, lit - 15);
+    }
+    out.append(literals);
+    if (match == 0) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (ml >= 15) {
+        put_length(out, ml - 15);
+    }
+}
+} // namespace
+
+std::string compress(std::string_view src) {
+    std::string out;
+    out.reserve(src.size() / 2 + 16);
+    std::vector<int64_t> table(size_t{1} << HASH_BITS, -1);
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + MIN_MATCH <= src.size()) {
+        uint32_t v = load32(src.data() + i);
+        uint32_t h = (v * 2654435761U) >> (32 - HASH_BITS);
+        int64_t cand = table[h];
+        table[h] = static_cast<int64_t>(i);
+        if (cand < 0 || i - cand > MAX_OFFSET || load32(src.data() + cand) != v) {
+            ++i;
+            continue;
+        }
+        size_t len = MIN_MATCH;
+        while (i + len < src.size() && src[cand + len] == src[i + len]) {
+            ++len;
+        }
+        put_sequence(out, src.substr(anchor, i - anchor), i - cand, len);
+        i += len;
+        anchor = i;
+    }
+    put_sequence(out, src.substr(anchor), 0, 0);
+    return out;
+}
+
+std::string decompress(std::string_view src, size_t rawSize) {
+    std::string out;
+    out.reserve(rawSize);
+    size_t pos = 0;
+    while (out.size() < rawSize || pos < src.size()) {
+        if (pos >= src.size()) {
+            throw std::invalid_argument("corrupt compressed data");
+        }
+        auto token = static_cast<uint8_t>(src[pos++]);
+        size_t lit = get_length(src, pos, token >> 4);
+        if (pos + lit > src.size() || out.size() + lit > rawSize) {
+            throw std::invalid_argument("corrupt compressed data");
+        }
+        out.append(src.substr(pos, lit));
+        pos += lit;
+        if (pos == src.size()) {
+            break;
+        }
+        if (pos + 2 > src.size()) {
+            throw std::invalid_argument("corrupt compressed data");
+        }
+        size_t offset = static_cast<uint8_t>(src[pos]) | (static_cast<size_t>(static_cast<uint8_t>(src[pos + 1])) << 8);
+        pos += 2;
+        size_t len = get_length(src, pos, token & 0xF) + MIN_MATCH;
+        if (offset == 0 || offset > out.size() || out.size() + len > rawSize) {
+            throw std::invalid_argument("corrupt compressed data");
+        }
+        size_t from = out.size() - offset;
+        for (size_t k = 0; k < len; ++k) {
+            out.push_back(out[from + k]);
+        }
+    }
+    if (out.size() != rawSize) {
+        throw std::invalid_argument("corrupt compressed data");
+    }
+    return out;
+}
+} // namespace LZ
+
+bool Utils::isObjectId(std::string_view id) {
+    return id.size() == UID_LENGTH &&
+           std::ranges::all_of(id, [](char c) { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+}
+
 /* FILE DELETION */
 /** Deletes FILE if it exists and is not a directory.  Returns true
  *  if FILE was deleted, and false otherwise.  Refuses to delete FILE
@@ -192,21 +425,43 @@ void Utils::writeContents(const std::string& content, const std::filesystem::pat
     auto parent = filePath.parent_path();
     std::filesystem::create_directories(parent);
 
-    std::ofstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::invalid_argument("cannot open file");
-    }
-
-    file.write(content.c_str(), static_cast<std::streamsize>(content.size()));
+    durable::write_file(filePath, content);
 }
 
 void Utils::writeContents_safe(const std::string& content, const std::filesystem::path& filePath) {
-    std::ofstream file(filePath, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::invalid_argument("cannot open file");
-    }
+    durable::write_file(filePath, content);
+}
 
-    file.write(content.c_str(), static_cast<std::streamsize>(content.size()));
+void Utils::linkOrCopy(const std::filesystem::path& from, const std::filesystem::path& to) {
+    std::error_code ec;
+    fs::create_hard_link(from, to, ec);
+    // 目标已存在：对象内容由 ID 决定，已有的那份就是同样的数据
+    if (!ec || ec == std::errc::file_exists) {
+        return;
+    }
+#ifdef __linux__
+    // 跨文件系统或不允许硬链接时，写时复制的文件系统（btrfs、XFS）仍可共享数据块
+    int in = ::open(from.c_str(), O_RDONLY);
+    if (in >= 0) {
+        int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (out >= 0) {
+            bool cloned = ::ioctl(out, FICLONE, in) == 0;
+            ::close(out);
+            ::close(in);
+            if (cloned) {
+                return;
+            }
+            fs::remove(to);
+        } else {
+            bool exists = errno == EEXIST;
+            ::close(in);
+            if (exists) {
+                return;
+            }
+        }
+    }
+#endif
+    fs::copy_file(from, to, fs::copy_options::skip_existing);
 }
 
 /** Print a message composed from MSG and ARGS as for the String.format